@@ -0,0 +1,89 @@
+#pragma once
+// host stand-in for the teensy core, see hal_native.h for the simulation hooks
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+#include <algorithm>
+#endif
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+
+#define FALLING 2
+#define RISING 3
+#define CHANGE 4
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define PIN_SPI_MOSI 11
+#define PIN_SPI_SCK 13
+
+#define HAL_NATIVE_PIN_COUNT 64
+
+#ifndef M_TWOPI
+#define M_TWOPI (M_PI * 2.0)
+#endif
+
+#define F_CPU_ACTUAL 600000000
+
+#ifdef __cplusplus
+
+template <class A, class B>
+constexpr auto min(A a, B b) {
+    return a < b ? a : b;
+}
+
+template <class A, class B>
+constexpr auto max(A a, B b) {
+    return a < b ? b : a;
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void digitalWriteFast(uint8_t pin, uint8_t value);
+uint8_t digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReadAveraging(unsigned int samples);
+
+// delays do not sleep, they advance the simulated clock
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void delayNanoseconds(uint32_t ns);
+uint32_t micros();
+uint32_t millis();
+
+void noInterrupts();
+void interrupts();
+
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t pin, void (*function)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+class usb_serial_class {
+   public:
+    void begin(long baud) {}
+    int available();
+    int read();
+    explicit operator bool() const { return true; }
+};
+
+extern usb_serial_class Serial;
+
+class HardwareSerial {
+   public:
+    void begin(long baud) {}
+};
+
+extern HardwareSerial Serial8;
+
+#endif
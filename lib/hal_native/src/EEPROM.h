@@ -0,0 +1,14 @@
+#pragma once
+#include "Arduino.h"
+
+#define E2END 4283  // teensy 4.1 emulated eeprom
+
+class EEPROMClass {
+   public:
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value);
+    uint16_t length() { return E2END + 1; }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,16 @@
+#pragma once
+#include "Arduino.h"
+
+#define INTERVAL_TIMER_COUNT 4
+
+// fired from hal_native_poll() and from within delays while interrupts are enabled
+class IntervalTimer {
+    int slot = -1;
+
+   public:
+    ~IntervalTimer();
+    bool begin(void (*function)(), uint32_t microseconds);
+    void update(uint32_t microseconds);
+    void end();
+    void priority(uint8_t n) {}
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "Arduino.h"
+
+#define MIDI_CHANNEL_OMNI 0
+#define MIDI_PORT_QUEUE_SIZE 256
+
+namespace midi {
+enum MidiType : uint8_t {
+    NoteOff = 0x80,
+    NoteOn = 0x90,
+    ControlChange = 0xB0,
+    Clock = 0xF8,
+    Start = 0xFA,
+    Continue = 0xFB,
+    Stop = 0xFC,
+};
+}
+
+struct MidiMessage {
+    midi::MidiType type;
+    uint8_t data1, data2, channel;
+};
+
+/**
+ * Input and output of one midi port. Incoming messages are queued with
+ * hal_native_midi_push() and dispatched to the handlers by read(), outgoing
+ * messages are only counted.
+ */
+class MidiPort {
+    MidiMessage queue[MIDI_PORT_QUEUE_SIZE];
+    int head = 0, count = 0;
+
+    void (*handleNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity) = nullptr;
+    void (*handleNoteOff)(uint8_t channel, uint8_t note, uint8_t velocity) = nullptr;
+    void (*handleControlChange)(uint8_t channel, uint8_t control, uint8_t value) = nullptr;
+    void (*handleClock)() = nullptr;
+    void (*handleStart)() = nullptr;
+    void (*handleStop)() = nullptr;
+    void (*handleContinue)() = nullptr;
+
+   public:
+    uint32_t sent = 0;
+
+    void begin(int channel = MIDI_CHANNEL_OMNI) {}
+    bool read(int channel = MIDI_CHANNEL_OMNI);
+    bool push(const MidiMessage& message);
+
+    void sendNoteOn(uint8_t note, uint8_t velocity, uint8_t channel) { sent++; }
+    void sendNoteOff(uint8_t note, uint8_t velocity, uint8_t channel) { sent++; }
+    void sendClock() { sent++; }
+
+    void setHandleNoteOn(void (*callback)(uint8_t, uint8_t, uint8_t)) { handleNoteOn = callback; }
+    void setHandleNoteOff(void (*callback)(uint8_t, uint8_t, uint8_t)) { handleNoteOff = callback; }
+    void setHandleControlChange(void (*callback)(uint8_t, uint8_t, uint8_t)) { handleControlChange = callback; }
+    void setHandleClock(void (*callback)()) { handleClock = callback; }
+    void setHandleStart(void (*callback)()) { handleStart = callback; }
+    void setHandleStop(void (*callback)()) { handleStop = callback; }
+    void setHandleContinue(void (*callback)()) { handleContinue = callback; }
+};
+
+#define MIDI_CREATE_INSTANCE(Type, SerialPort, Name) MidiPort Name;
@@ -0,0 +1,31 @@
+#pragma once
+#include "Arduino.h"
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+   public:
+    uint32_t clock = 4000000;
+    uint8_t bitOrder = MSBFIRST, dataMode = SPI_MODE0;
+
+    SPISettings() {}
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+};
+
+// hardware spi, transfers are only counted
+class SPIClass {
+   public:
+    void begin() {}
+    void setMOSI(uint8_t pin) {}
+    void setSCK(uint8_t pin) {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t data);
+    uint16_t transfer16(uint16_t data);
+};
+
+extern SPIClass SPI;
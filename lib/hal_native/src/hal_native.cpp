@@ -0,0 +1,436 @@
+#include "hal_native.h"
+
+#include <EEPROM.h>
+#include <IntervalTimer.h>
+#include <SPI.h>
+#include <time.h>
+#include <usb_midi.h>
+
+usb_serial_class Serial;
+HardwareSerial Serial8;
+SPIClass SPI;
+EEPROMClass EEPROM;
+MidiPort usbMIDI;
+
+static HalNativeStats stats;
+
+/* clock */
+
+static uint64_t simulatedNanos = 0;  // added on top of wall time by delays
+static uint64_t delayRemainderNanos = 0;
+
+static bool wallPaused = false;
+static uint64_t wallPausedAt = 0, wallPausedTotal = 0;
+
+static uint64_t hostMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static uint64_t wallMicros() {
+    static uint64_t start = 0;
+    uint64_t now = wallPaused ? wallPausedAt : hostMicros();
+    if (start == 0) {
+        start = now;
+    }
+    return now - start - wallPausedTotal;
+}
+
+static uint64_t nowMicros() {
+    return wallMicros() + simulatedNanos / 1000;
+}
+
+uint64_t hal_native_nanos() {
+    return wallMicros() * 1000 + simulatedNanos;
+}
+
+void hal_native_pause_wall_clock(bool paused) {
+    if (paused == wallPaused) {
+        return;
+    }
+    if (paused) {
+        wallMicros();  // starts the clock if this is the first call
+        wallPausedAt = hostMicros();
+    } else {
+        wallPausedTotal += hostMicros() - wallPausedAt;
+    }
+    wallPaused = paused;
+}
+
+uint32_t micros() {
+    return (uint32_t)nowMicros();
+}
+
+uint32_t millis() {
+    return (uint32_t)(nowMicros() / 1000);
+}
+
+void hal_native_advance(uint32_t us) {
+    simulatedNanos += us * 1000ull;
+    hal_native_poll();
+}
+
+void delay(uint32_t ms) {
+    stats.delayMicros += ms * 1000ull;
+    hal_native_advance(ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    stats.delayMicros += us;
+    hal_native_advance(us);
+}
+
+void delayNanoseconds(uint32_t ns) {
+    delayRemainderNanos += ns;
+    stats.delayMicros += delayRemainderNanos / 1000;
+    delayRemainderNanos %= 1000;
+    simulatedNanos += ns;
+    hal_native_poll();
+}
+
+/* interrupts and timers */
+
+static int interruptsDisabled = 0;
+static bool inInterrupt = false;
+
+struct TimerSlot {
+    void (*function)() = nullptr;
+    uint32_t period = 0;
+    uint64_t next = 0;
+};
+
+static TimerSlot timers[INTERVAL_TIMER_COUNT];
+
+void noInterrupts() {
+    interruptsDisabled++;
+}
+
+void interrupts() {
+    if (interruptsDisabled > 0) {
+        interruptsDisabled--;
+    }
+}
+
+void hal_native_poll() {
+    if (interruptsDisabled || inInterrupt) {
+        return;
+    }
+    inInterrupt = true;
+    uint64_t now = nowMicros();
+    for (int i = 0; i < INTERVAL_TIMER_COUNT; i++) {
+        TimerSlot& timer = timers[i];
+        if (!timer.function || timer.period == 0 || now < timer.next) {
+            continue;
+        }
+        // the pit keeps its grid, missed periods collapse into a single pending interrupt
+        timer.next += ((now - timer.next) / timer.period + 1) * timer.period;
+        stats.timerCallbacks++;
+        timer.function();
+    }
+    inInterrupt = false;
+}
+
+IntervalTimer::~IntervalTimer() {
+    end();
+}
+
+bool IntervalTimer::begin(void (*function)(), uint32_t microseconds) {
+    if (slot < 0) {
+        for (int i = 0; i < INTERVAL_TIMER_COUNT; i++) {
+            if (!timers[i].function) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            return false;
+        }
+    }
+    timers[slot].function = function;
+    timers[slot].period = microseconds;
+    timers[slot].next = nowMicros() + microseconds;
+    return true;
+}
+
+void IntervalTimer::update(uint32_t microseconds) {
+    if (slot >= 0) {
+        // takes effect after the current period, as on the teensy
+        timers[slot].period = microseconds;
+    }
+}
+
+void IntervalTimer::end() {
+    if (slot >= 0) {
+        timers[slot] = TimerSlot();
+        slot = -1;
+    }
+}
+
+static void (*pinInterrupts[HAL_NATIVE_PIN_COUNT])();
+
+void attachInterrupt(uint8_t pin, void (*function)(), int mode) {
+    if (pin < HAL_NATIVE_PIN_COUNT) {
+        pinInterrupts[pin] = function;
+    }
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < HAL_NATIVE_PIN_COUNT) {
+        pinInterrupts[pin] = nullptr;
+    }
+}
+
+void hal_native_trigger_interrupt(uint8_t pin) {
+    if (pin < HAL_NATIVE_PIN_COUNT && pinInterrupts[pin] && !interruptsDisabled) {
+        pinInterrupts[pin]();
+    }
+}
+
+/* pins */
+
+static uint8_t pinModes[HAL_NATIVE_PIN_COUNT];
+static uint8_t digitalInputs[HAL_NATIVE_PIN_COUNT];
+static uint8_t digitalOutputs[HAL_NATIVE_PIN_COUNT];
+static int analogInputs[HAL_NATIVE_PIN_COUNT];
+static void (*writeHook)(uint8_t pin, uint8_t value) = nullptr;
+static HalNativeDevice* devices[HAL_NATIVE_MAX_DEVICES];
+static HalNativeEdge* edgeBuffer = nullptr;
+static int edgeCapacity = 0, edgeCount = 0;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= HAL_NATIVE_PIN_COUNT) {
+        return;
+    }
+    pinModes[pin] = mode;
+    if (mode == INPUT_PULLUP) {
+        digitalInputs[pin] = HIGH;
+    } else if (mode == INPUT_PULLDOWN) {
+        digitalInputs[pin] = LOW;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    stats.digitalWrites++;
+    if (pin >= HAL_NATIVE_PIN_COUNT) {
+        return;
+    }
+    uint8_t level = value ? HIGH : LOW;
+    bool changed = level != digitalOutputs[pin];
+    digitalOutputs[pin] = level;
+    if (changed) {
+        stats.edges++;
+        uint64_t nanos = hal_native_nanos();
+        if (edgeCount < edgeCapacity) {
+            edgeBuffer[edgeCount++] = {nanos, pin, level};
+        }
+        for (HalNativeDevice* device : devices) {
+            if (device) device->edge(pin, level, nanos);
+        }
+    }
+    if (writeHook) {
+        writeHook(pin, digitalOutputs[pin]);
+    }
+}
+
+void digitalWriteFast(uint8_t pin, uint8_t value) {
+    digitalWrite(pin, value);
+}
+
+uint8_t digitalRead(uint8_t pin) {
+    return pin < HAL_NATIVE_PIN_COUNT ? digitalInputs[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+    return pin < HAL_NATIVE_PIN_COUNT ? analogInputs[pin] : 0;
+}
+
+void analogReadAveraging(unsigned int samples) {}
+
+void hal_native_set_digital(uint8_t pin, uint8_t level) {
+    if (pin < HAL_NATIVE_PIN_COUNT) {
+        digitalInputs[pin] = level ? HIGH : LOW;
+    }
+}
+
+void hal_native_set_analog(uint8_t pin, int value) {
+    if (pin < HAL_NATIVE_PIN_COUNT) {
+        analogInputs[pin] = value;
+    }
+}
+
+uint8_t hal_native_get_digital(uint8_t pin) {
+    return pin < HAL_NATIVE_PIN_COUNT ? digitalOutputs[pin] : LOW;
+}
+
+void hal_native_set_write_hook(void (*hook)(uint8_t pin, uint8_t value)) {
+    writeHook = hook;
+}
+
+bool hal_native_attach_device(HalNativeDevice* device) {
+    for (HalNativeDevice*& slot : devices) {
+        if (!slot) {
+            slot = device;
+            return true;
+        }
+    }
+    return false;
+}
+
+void hal_native_detach_device(HalNativeDevice* device) {
+    for (HalNativeDevice*& slot : devices) {
+        if (slot == device) {
+            slot = nullptr;
+        }
+    }
+}
+
+void hal_native_record_edges(HalNativeEdge* buffer, int capacity) {
+    edgeBuffer = buffer;
+    edgeCapacity = buffer ? capacity : 0;
+    edgeCount = 0;
+}
+
+int hal_native_recorded_edges() {
+    return edgeCount;
+}
+
+/* spi */
+
+void SPIClass::beginTransaction(SPISettings settings) {}
+
+void SPIClass::endTransaction() {}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    stats.spiTransfers++;
+    return 0;
+}
+
+uint16_t SPIClass::transfer16(uint16_t data) {
+    stats.spiTransfers++;
+    return 0;
+}
+
+/* eeprom, erased cells read 0xff */
+
+static uint8_t eepromCells[E2END + 1];
+static bool eepromErased = false;
+
+static void eepromInit() {
+    if (!eepromErased) {
+        memset(eepromCells, 0xff, sizeof(eepromCells));
+        eepromErased = true;
+    }
+}
+
+uint8_t EEPROMClass::read(int address) {
+    eepromInit();
+    return address >= 0 && address <= E2END ? eepromCells[address] : 0;
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+    eepromInit();
+    if (address >= 0 && address <= E2END) {
+        eepromCells[address] = value;
+    }
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+    write(address, value);
+}
+
+/* midi */
+
+bool MidiPort::push(const MidiMessage& message) {
+    if (count >= MIDI_PORT_QUEUE_SIZE) {
+        return false;
+    }
+    queue[(head + count) % MIDI_PORT_QUEUE_SIZE] = message;
+    count++;
+    return true;
+}
+
+bool MidiPort::read(int channel) {
+    if (count == 0) {
+        return false;
+    }
+    MidiMessage m = queue[head];
+    head = (head + 1) % MIDI_PORT_QUEUE_SIZE;
+    count--;
+
+    bool isChannelMessage = m.type < 0xF0;
+    if (isChannelMessage && channel != MIDI_CHANNEL_OMNI && m.channel != channel) {
+        return true;
+    }
+
+    switch (m.type) {
+        case midi::NoteOn:
+            if (m.data2 == 0) {
+                if (handleNoteOff) handleNoteOff(m.channel, m.data1, 0);
+            } else if (handleNoteOn) {
+                handleNoteOn(m.channel, m.data1, m.data2);
+            }
+            break;
+        case midi::NoteOff:
+            if (handleNoteOff) handleNoteOff(m.channel, m.data1, m.data2);
+            break;
+        case midi::ControlChange:
+            if (handleControlChange) handleControlChange(m.channel, m.data1, m.data2);
+            break;
+        case midi::Clock:
+            if (handleClock) handleClock();
+            break;
+        case midi::Start:
+            if (handleStart) handleStart();
+            break;
+        case midi::Stop:
+            if (handleStop) handleStop();
+            break;
+        case midi::Continue:
+            if (handleContinue) handleContinue();
+            break;
+    }
+    return true;
+}
+
+bool hal_native_midi_push(MidiPort& port, midi::MidiType type, uint8_t data1, uint8_t data2, uint8_t channel) {
+    return port.push({type, data1, data2, channel});
+}
+
+/* serial */
+
+#define SERIAL_INPUT_SIZE 64
+
+static char serialInput[SERIAL_INPUT_SIZE];
+static int serialHead = 0, serialCount = 0;
+
+int usb_serial_class::available() {
+    return serialCount;
+}
+
+int usb_serial_class::read() {
+    if (serialCount == 0) {
+        return -1;
+    }
+    char c = serialInput[serialHead];
+    serialHead = (serialHead + 1) % SERIAL_INPUT_SIZE;
+    serialCount--;
+    return c;
+}
+
+void hal_native_serial_push(const char* text) {
+    for (; *text && serialCount < SERIAL_INPUT_SIZE; text++) {
+        serialInput[(serialHead + serialCount) % SERIAL_INPUT_SIZE] = *text;
+        serialCount++;
+    }
+}
+
+/* stats */
+
+const HalNativeStats& hal_native_get_stats() {
+    return stats;
+}
+
+void hal_native_reset_stats() {
+    stats = HalNativeStats();
+}
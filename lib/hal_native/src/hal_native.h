@@ -0,0 +1,64 @@
+#pragma once
+#include "Arduino.h"
+#include "MIDI.h"
+
+// bookkeeping of the simulated hardware, bus delays are summed instead of waited
+struct HalNativeStats {
+    uint64_t digitalWrites = 0;
+    uint64_t edges = 0;  // writes which changed the level
+    uint64_t spiTransfers = 0;
+    uint64_t delayMicros = 0;  // simulated time spent in delays
+    uint64_t timerCallbacks = 0;
+};
+
+// input levels seen by digitalRead and analogRead
+void hal_native_set_digital(uint8_t pin, uint8_t level);
+void hal_native_set_analog(uint8_t pin, int value);
+// last level written by digitalWrite
+uint8_t hal_native_get_digital(uint8_t pin);
+// called after every digitalWrite, lets device models follow the pins
+void hal_native_set_write_hook(void (*hook)(uint8_t pin, uint8_t value));
+
+// peripheral model following the output pins, see hal_native_devices.h
+class HalNativeDevice {
+   public:
+    virtual ~HalNativeDevice() {}
+    // every level change of an output, in the order written
+    virtual void edge(uint8_t pin, uint8_t level, uint64_t nanos) = 0;
+};
+
+#define HAL_NATIVE_MAX_DEVICES 8
+
+// false if all device slots are taken
+bool hal_native_attach_device(HalNativeDevice* device);
+void hal_native_detach_device(HalNativeDevice* device);
+
+struct HalNativeEdge {
+    uint64_t nanos;  // hal_native_nanos() of the write
+    uint8_t pin;
+    uint8_t level;
+};
+
+// records output level changes into the buffer until it is full, nullptr stops
+void hal_native_record_edges(HalNativeEdge* buffer, int capacity);
+int hal_native_recorded_edges();
+
+// calls the handler attached to the pin as if the edge had happened
+void hal_native_trigger_interrupt(uint8_t pin);
+
+// runs the interval timers which are due, unless interrupts are disabled
+void hal_native_poll();
+// moves the simulated clock forward without wall time passing
+void hal_native_advance(uint32_t us);
+// simulated time with the resolution of delayNanoseconds()
+uint64_t hal_native_nanos();
+// while paused only delays move the clock, waveforms are then exact
+void hal_native_pause_wall_clock(bool paused);
+
+bool hal_native_midi_push(MidiPort& port, midi::MidiType type, uint8_t data1, uint8_t data2, uint8_t channel = 1);
+
+// bytes for Serial.read(), used to script serial commands
+void hal_native_serial_push(const char* text);
+
+const HalNativeStats& hal_native_get_stats();
+void hal_native_reset_stats();
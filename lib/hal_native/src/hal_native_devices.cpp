@@ -0,0 +1,167 @@
+#include "hal_native_devices.h"
+
+/* spi slave */
+
+SpiSlaveModel::SpiSlaveModel(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin, SpiTiming timing, bool shiftsDeselected)
+    : csPin(csPin), mosiPin(mosiPin), sckPin(sckPin), shiftsDeselected(shiftsDeselected), timing(timing) {
+    // levels as they are now, the pins may have been set before attaching
+    selected = !hal_native_get_digital(csPin);
+    mosi = hal_native_get_digital(mosiPin);
+    sck = hal_native_get_digital(sckPin);
+}
+
+void SpiSlaveModel::edge(uint8_t pin, uint8_t level, uint64_t nanos) {
+    if (pin == mosiPin) {
+        mosi = level;
+    }
+    if (pin == sckPin) {
+        sck = level;
+        if (selected && frameBits == 0 && level && nanos - selectNanos < timing.setupNanos) {
+            stats.setupViolations++;
+        }
+        if (level && (selected || shiftsDeselected)) {
+            shift(mosi);
+            frameBits++;
+            lastClockNanos = nanos;  // hold is counted from the sampling edge
+        }
+    }
+    if (pin == csPin) {
+        if (sck) {
+            stats.clockNotIdle++;
+        }
+        if (!level) {
+            selected = true;
+            selectNanos = nanos;
+            if (!shiftsDeselected) {
+                frameBits = 0;
+            }
+        } else if (selected) {
+            selected = false;
+            if (frameBits > 0 && nanos - lastClockNanos < timing.holdNanos) {
+                stats.holdViolations++;
+            }
+            stats.busyNanos += nanos - selectNanos;
+            stats.frames++;
+            if (!latch(frameBits)) {
+                stats.framingErrors++;
+            }
+            frameBits = 0;
+        }
+    }
+}
+
+const SpiSlaveStats& SpiSlaveModel::getStats() const {
+    return stats;
+}
+
+void SpiSlaveModel::resetStats() {
+    stats = SpiSlaveStats();
+}
+
+/* dac chain */
+
+DacChainModel::DacChainModel(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin, int chips, float referenceVolts)
+    : SpiSlaveModel(csPin, mosiPin, sckPin, {50, 50}),
+      chips(chips < MAX_CHIPS ? chips : MAX_CHIPS),
+      referenceVolts(referenceVolts) {}
+
+void DacChainModel::shift(bool bit) {
+    for (int c = chips - 1; c > 0; c--) {
+        chain[c] = (chain[c] << 1) | (chain[c - 1] >> 15);
+    }
+    chain[0] = (chain[0] << 1) | bit;
+}
+
+// every chip latches the word it holds, the first word shifted reaches the last chip
+bool DacChainModel::latch(int bits) {
+    for (int c = 0; c < chips; c++) {
+        int address = chain[c] >> 12;
+        if (address >= 1 && address <= 8) {
+            levels[c][address - 1] = (chain[c] >> 4) & 0xff;
+        }
+    }
+    return bits == 16 * chips;
+}
+
+uint8_t DacChainModel::level(int chip, int channel) const {
+    return levels[chip][channel];
+}
+
+float DacChainModel::volts(int chip, int channel) const {
+    return referenceVolts * levels[chip][channel] / 255.0f;
+}
+
+/* mcp4802 */
+
+Mcp4802Model::Mcp4802Model(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin)
+    : SpiSlaveModel(csPin, mosiPin, sckPin, {15, 10}) {}
+
+void Mcp4802Model::shift(bool bit) {
+    input = (input << 1) | bit;
+}
+
+bool Mcp4802Model::latch(int bits) {
+    if (bits != 16) {
+        return false;  // ignored by the chip
+    }
+    registers[input >> 15] = input;
+    return true;
+}
+
+uint8_t Mcp4802Model::code(int channel) const {
+    return (registers[channel] >> 4) & 0xff;
+}
+
+float Mcp4802Model::volts(int channel) const {
+    uint16_t r = registers[channel];
+    if (!(r & (1 << 12))) {
+        return 0;  // shut down
+    }
+    float gain = r & (1 << 13) ? 1 : 2;
+    return 2.048f * gain * code(channel) / 256;
+}
+
+/* pga2311 */
+
+Pga2311Model::Pga2311Model(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin)
+    : SpiSlaveModel(csPin, mosiPin, sckPin, {90, 90}) {}
+
+void Pga2311Model::shift(bool bit) {
+    input = (input << 1) | bit;
+}
+
+bool Pga2311Model::latch(int bits) {
+    if (bits != 16) {
+        return false;
+    }
+    gains[1] = input >> 8;
+    gains[0] = input & 0xff;
+    return true;
+}
+
+bool Pga2311Model::muted(int channel) const {
+    return gains[channel] == 0;
+}
+
+float Pga2311Model::gainDb(int channel) const {
+    return 31.5f - 0.5f * (255 - gains[channel]);
+}
+
+/* 74hc595 */
+
+ShiftRegisterModel::ShiftRegisterModel(uint8_t latchPin, uint8_t dataPin, uint8_t clockPin, int bits)
+    : SpiSlaveModel(latchPin, dataPin, clockPin, {20, 20}, true), bitCount(bits) {}
+
+void ShiftRegisterModel::shift(bool bit) {
+    input = (input << 1) | bit;
+}
+
+bool ShiftRegisterModel::latch(int bits) {
+    uint32_t mask = bitCount >= 32 ? 0xffffffff : (1u << bitCount) - 1;
+    outputs = input & mask;
+    return bits == bitCount;
+}
+
+uint32_t ShiftRegisterModel::getOutputs() const {
+    return outputs;
+}
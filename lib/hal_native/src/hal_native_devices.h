@@ -0,0 +1,104 @@
+#pragma once
+#include "hal_native.h"
+
+// minimum cs to first clock edge and last sampling edge to cs release
+struct SpiTiming {
+    uint32_t setupNanos;
+    uint32_t holdNanos;
+};
+
+struct SpiSlaveStats {
+    uint32_t frames = 0;
+    uint32_t framingErrors = 0;  // bit count the device does not take
+    uint32_t clockNotIdle = 0;   // cs changed with the clock high
+    uint32_t setupViolations = 0;
+    uint32_t holdViolations = 0;
+    uint64_t busyNanos = 0;  // cs held low
+};
+
+/**
+ * Mode 0, msb first slave on a mosi and sck pair. Bits are sampled on the
+ * rising clock edge while cs is low, the device latches on the rising cs
+ * edge. Protocol timing is checked against the simulated clock, so it is
+ * exact while the wall clock is paused and only errs long otherwise.
+ */
+class SpiSlaveModel : public HalNativeDevice {
+    uint8_t csPin, mosiPin, sckPin;
+    bool shiftsDeselected;
+    SpiTiming timing;
+
+    bool selected = false, mosi = LOW, sck = LOW;
+    uint64_t selectNanos = 0, lastClockNanos = 0;
+    int frameBits = 0;
+
+   protected:
+    SpiSlaveStats stats;
+    virtual void shift(bool bit) = 0;
+    // false if the bit count is a framing error
+    virtual bool latch(int bits) = 0;
+
+   public:
+    // shift registers clock in data whether selected or not, cs is then the latch
+    SpiSlaveModel(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin, SpiTiming timing, bool shiftsDeselected = false);
+    void edge(uint8_t pin, uint8_t level, uint64_t nanos) override;
+    const SpiSlaveStats& getStats() const;
+    void resetStats();
+};
+
+// daisy chained 8 channel 8 bit dacs, word = address 1-8 << 12 | level << 4
+class DacChainModel : public SpiSlaveModel {
+    static constexpr int MAX_CHIPS = 8;
+    int chips;
+    float referenceVolts;
+    uint16_t chain[MAX_CHIPS] = {};  // chain[0] is next to the mcu
+    uint8_t levels[MAX_CHIPS][8] = {};
+
+    void shift(bool bit) override;
+    bool latch(int bits) override;
+
+   public:
+    DacChainModel(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin, int chips, float referenceVolts = 5.0f);
+    uint8_t level(int chip, int channel) const;
+    float volts(int chip, int channel) const;
+};
+
+// MCP4802, channel b if bit 15, gain 1x if bit 13, active if bit 12
+class Mcp4802Model : public SpiSlaveModel {
+    uint16_t input = 0;
+    uint16_t registers[2] = {};
+
+    void shift(bool bit) override;
+    bool latch(int bits) override;
+
+   public:
+    Mcp4802Model(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin);
+    uint8_t code(int channel) const;
+    float volts(int channel) const;
+};
+
+// PGA2311, right gain byte first, 31.5 dB - 0.5 dB per step below 255, 0 mutes
+class Pga2311Model : public SpiSlaveModel {
+    uint16_t input = 0;
+    uint8_t gains[2] = {};  // left, right
+
+    void shift(bool bit) override;
+    bool latch(int bits) override;
+
+   public:
+    Pga2311Model(uint8_t csPin, uint8_t mosiPin, uint8_t sckPin);
+    bool muted(int channel) const;
+    float gainDb(int channel) const;
+};
+
+// chained 74HC595, latched by rclk, the first bit shifted ends up in the top output
+class ShiftRegisterModel : public SpiSlaveModel {
+    int bitCount;
+    uint32_t input = 0, outputs = 0;
+
+    void shift(bool bit) override;
+    bool latch(int bits) override;
+
+   public:
+    ShiftRegisterModel(uint8_t latchPin, uint8_t dataPin, uint8_t clockPin, int bits);
+    uint32_t getOutputs() const;
+};
@@ -0,0 +1,4 @@
+#pragma once
+#include "MIDI.h"
+
+extern MidiPort usbMIDI;
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+struct usb_string_descriptor_struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t wString[];
+};
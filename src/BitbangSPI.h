@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+// bits of the teensy SPI_MODE constants
+#define SPI_MODE_CPHA 0x04
+#define SPI_MODE_CPOL 0x08
+
+/**
+ * Bitbanged spi master with pins, bit order, mode and clock fixed at compile
+ * time. digitalWriteFast with a constant pin is a single store to the gpio
+ * set or clear register and delayNanoseconds counts cycles, so a bit costs
+ * its two half periods and four stores, without branching on the settings.
+ */
+template <uint8_t MosiPin, uint8_t SckPin, uint8_t BitOrder, uint8_t DataMode, uint32_t ClockHz>
+struct BitbangSPI {
+    static constexpr bool CPOL = DataMode & SPI_MODE_CPOL;
+    static constexpr bool CPHA = DataMode & SPI_MODE_CPHA;
+    static constexpr uint32_t HALF_PERIOD_NANOS = 500000000 / ClockHz;
+
+    static void transfer16(uint16_t data) {
+        for (int i = 0; i < 16; i++) {
+            bool bit = BitOrder == MSBFIRST ? data & (0x8000 >> i) : data & (1 << i);
+            if (!CPHA) {
+                // set up half a period before the leading edge, which samples it
+                digitalWriteFast(MosiPin, bit);
+                delayNanoseconds(HALF_PERIOD_NANOS);
+                digitalWriteFast(SckPin, !CPOL);
+                delayNanoseconds(HALF_PERIOD_NANOS);
+                digitalWriteFast(SckPin, CPOL);
+            } else {
+                // changed on the leading edge, sampled on the trailing one
+                digitalWriteFast(SckPin, !CPOL);
+                digitalWriteFast(MosiPin, bit);
+                delayNanoseconds(HALF_PERIOD_NANOS);
+                digitalWriteFast(SckPin, CPOL);
+                delayNanoseconds(HALF_PERIOD_NANOS);
+            }
+        }
+    }
+};
@@ -0,0 +1,155 @@
+#include "SPIBus.h"
+
+#include "config.h"
+
+bool SPIBus::submit(const SPIDevice& device, const uint16_t* words, int count, SPITicket* ticket) {
+    SPITransaction transaction;
+    transaction.device = &device;
+    transaction.submitMicros = micros();
+    transaction.count = count < SPI_MAX_WORDS ? count : SPI_MAX_WORDS;
+    for (int i = 0; i < transaction.count; i++) {
+        transaction.words[i] = words[i];
+    }
+
+    SPIPriority priority = device.priority;
+    if (!queues[priority].push(transaction)) {
+        stats[priority].dropped++;
+        return false;
+    }
+    submitted[priority]++;
+    if (ticket) {
+        *ticket = {priority, submitted[priority]};
+    }
+    return true;
+}
+
+void SPIBus::service() {
+    run(0, SPI_PRIORITY__COUNT__ - 1);
+}
+
+void SPIBus::service(SPIPriority priority) {
+    run(priority, priority);
+}
+
+void SPIBus::run(int first, int last) {
+    // an interrupt always runs to the end, so only the main loop can find the bus held
+    if (active) {
+        return;
+    }
+    active = true;
+    const SPIWrapperSettings* session = nullptr;
+    SPITransaction transaction;
+    while (popNext(transaction, first, last)) {
+        const SPIWrapperSettings& settings = transaction.device->settings;
+        if (session && !session->matches(settings)) {
+            spiWrapper.endTransaction();
+            session = nullptr;
+        }
+        if (!session) {
+            spiWrapper.beginTransaction(settings);
+            session = &settings;
+            sessions++;
+        }
+        execute(transaction);
+    }
+    if (session) {
+        spiWrapper.endTransaction();
+    }
+    active = false;
+}
+
+bool SPIBus::isDone(const SPITicket& ticket) const {
+    return (int32_t)(completed[ticket.priority] - ticket.sequence) >= 0;
+}
+
+void SPIBus::wait(const SPITicket& ticket) {
+    while (!isDone(ticket)) {
+        service();
+    }
+}
+
+bool SPIBus::popNext(SPITransaction& transaction, int first, int last) {
+    for (int priority = first; priority <= last; priority++) {
+        if (queues[priority].pop(transaction)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SPIBus::execute(const SPITransaction& transaction) {
+    const SPIDevice& device = *transaction.device;
+    uint32_t start = micros();
+
+    digitalWrite(device.csPin, LOW);
+    spiWrapper.traceSelect(device.id);
+    if (device.selectMicros) {
+        delayMicroseconds(device.selectMicros);
+    }
+    for (int i = 0; i < transaction.count; i++) {
+        spiWrapper.transfer16(transaction.words[i]);
+        if (device.wordMicros) {
+            delayMicroseconds(device.wordMicros);
+        }
+    }
+    digitalWrite(device.csPin, HIGH);
+    spiWrapper.traceDeselect();
+    if (device.deselectMicros) {
+        delayMicroseconds(device.deselectMicros);
+    }
+
+    uint32_t end = micros();
+    uint32_t latency = end - transaction.submitMicros;
+    SPIBusStats& s = stats[device.priority];
+    s.transactions++;
+    s.words += transaction.count;
+    s.busyMicros += end - start;
+    s.latencySumMicros += latency;
+    if (latency > s.maxLatencyMicros) {
+        s.maxLatencyMicros = latency;
+    }
+    completed[device.priority] = completed[device.priority] + 1;
+}
+
+const SPIBusStats& SPIBus::getStats(SPIPriority priority) const {
+    return stats[priority];
+}
+
+void SPIBus::resetStats() {
+    noInterrupts();
+    for (int i = 0; i < SPI_PRIORITY__COUNT__; i++) {
+        stats[i] = SPIBusStats();
+    }
+    sessions = 0;
+    spiWrapper.resetStats();
+    statsSinceMicros = micros();
+    interrupts();
+}
+
+void SPIBus::printStats() {
+    static const char* names[SPI_PRIORITY__COUNT__] = {"dac", "keybed", "audio", "leds"};
+    uint32_t elapsed = micros() - statsSinceMicros;
+    uint64_t busy = 0;
+    uint32_t transactions = 0;
+
+    printf("\n%-8s%14s%8s%10s%12s%12s%12s\n", "spi", "transactions", "words", "dropped", "busy us", "mean us", "max us");
+    for (int i = 0; i < SPI_PRIORITY__COUNT__; i++) {
+        noInterrupts();
+        SPIBusStats s = stats[i];
+        interrupts();
+        busy += s.busyMicros;
+        transactions += s.transactions;
+        printf("%-8s%14lu%8lu%10lu%12llu%12.1f%12lu\n", names[i],
+               (unsigned long)s.transactions, (unsigned long)s.words, (unsigned long)s.dropped,
+               (unsigned long long)s.busyMicros,
+               s.transactions ? (double)s.latencySumMicros / s.transactions : 0.0,
+               (unsigned long)s.maxLatencyMicros);
+    }
+    printf("spi utilization %.1f %% over %lu ms\n", elapsed ? 100.0 * busy / elapsed : 0.0, (unsigned long)(elapsed / 1000));
+    const SPIWrapperStats& wrapper = spiWrapper.getStats();
+    printf("spi: %lu transactions in %lu sessions, %lu reconfigurations, %lu avoided\n",
+           (unsigned long)transactions, (unsigned long)sessions, (unsigned long)wrapper.reconfigurations,
+           (unsigned long)(wrapper.transactions - wrapper.reconfigurations));
+}
+
+SPIBus spiBus;
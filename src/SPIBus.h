@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "SPIWrapper.h"
+#include "spscqueue.h"
+
+// longest transaction, one word per dac of the daisy chain
+#define SPI_MAX_WORDS 8
+#define SPI_QUEUE_SIZE 16
+
+// lower runs first
+enum SPIPriority {
+    SPI_PRIORITY_DAC,
+    SPI_PRIORITY_KEYBED,
+    SPI_PRIORITY_AUDIO,
+    SPI_PRIORITY_LEDS,
+    SPI_PRIORITY__COUNT__,
+};
+
+struct SPIDevice {
+    SPIDeviceId id;
+    const SPIWrapperSettings& settings;
+    uint8_t csPin;  // active low, also used for latch pins
+    SPIPriority priority;
+    uint8_t selectMicros;    // after pulling cs low
+    uint8_t wordMicros;      // after every word
+    uint8_t deselectMicros;  // after releasing cs
+};
+
+struct SPITransaction {
+    const SPIDevice* device;
+    uint32_t submitMicros;
+    uint8_t count;
+    uint16_t words[SPI_MAX_WORDS];
+};
+
+// ticket of a submitted transaction, see isDone()
+struct SPITicket {
+    SPIPriority priority;
+    uint32_t sequence;
+};
+
+struct SPIBusStats {
+    uint32_t transactions = 0;
+    uint32_t words = 0;
+    uint32_t dropped = 0;  // queue was full
+    uint64_t busyMicros = 0;
+    // submit until the transaction is done
+    uint64_t latencySumMicros = 0;
+    uint32_t maxLatencyMicros = 0;
+};
+
+/**
+ * Shared spi bus. Transactions are queued per priority and executed in
+ * priority order by service(), dac frames first, then keybed rows, audio
+ * path and leds. A caller submits all its transactions and then services
+ * the bus. If the bus is held, whoever holds it picks the transactions up
+ * after its current one, so callers never wait for the bus. Completion can
+ * be checked with isDone().
+ *
+ * Consecutive transactions with matching wrapper settings share one bus
+ * session, so the wrapper is only begun and ended once for all of them.
+ *
+ * Each priority has one producer, the keybed row is submitted from the
+ * scan interrupt and everything else from the main loop. The interrupt only
+ * services its own priority, so the main loop's transactions never run at
+ * interrupt priority. An interrupt which finds the bus held leaves its
+ * transaction to the main loop.
+ */
+class SPIBus {
+    SpscQueue<SPITransaction, SPI_QUEUE_SIZE> queues[SPI_PRIORITY__COUNT__];
+    uint32_t submitted[SPI_PRIORITY__COUNT__] = {};
+    volatile uint32_t completed[SPI_PRIORITY__COUNT__] = {};
+    volatile bool active = false;
+
+    SPIBusStats stats[SPI_PRIORITY__COUNT__];
+    uint32_t sessions = 0;
+    uint32_t statsSinceMicros = 0;
+
+    bool popNext(SPITransaction& transaction, int first, int last);
+    void run(int first, int last);
+    void execute(const SPITransaction& transaction);
+
+   public:
+    // queues without starting, false if the queue of the device is full
+    bool submit(const SPIDevice& device, const uint16_t* words, int count, SPITicket* ticket = nullptr);
+    // runs queued transactions unless the bus is already held
+    void service();
+    // runs the queue of one priority only, for the interrupt submitting it
+    void service(SPIPriority priority);
+    bool isDone(const SPITicket& ticket) const;
+    // runs the queue until the ticket is done, for tests outside the control loop
+    void wait(const SPITicket& ticket);
+
+    const SPIBusStats& getStats(SPIPriority priority) const;
+    void resetStats();
+    void printStats();
+};
+
+extern SPIBus spiBus;
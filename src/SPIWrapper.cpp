@@ -5,11 +5,29 @@
 SPIWrapperSettings::SPIWrapperSettings(uint32_t clk, uint8_t order, uint8_t mode, uint8_t mosiPin, uint8_t sckPin)
     : clock(clk), bitOrder(order), dataMode(mode), mosi_pin(mosiPin), sck_pin(sckPin) {}
 
+bool SPIWrapperSettings::matches(const SPIWrapperSettings& other) const {
+    return clock == other.clock && bitOrder == other.bitOrder && dataMode == other.dataMode &&
+           mosi_pin == other.mosi_pin && sck_pin == other.sck_pin && bitbangTransfer16 == other.bitbangTransfer16;
+}
+
 SPIWrapper::SPIWrapper(uint32_t bitbangThreshold)
     : bitbang_threshold(bitbangThreshold), use_bitbang(false), current_settings(4000000, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK) {
 }
 
+// pins and the hardware peripheral keep their configuration between transactions
 void SPIWrapper::beginTransaction(const SPIWrapperSettings& settings) {
+    stats.transactions++;
+    if (!configured || !current_settings.matches(settings)) {
+        configure(settings);
+        stats.reconfigurations++;
+    }
+    if (!use_bitbang) {
+        SPI.beginTransaction(hardware_settings);
+    }
+}
+
+void SPIWrapper::configure(const SPIWrapperSettings& settings) {
+    configured = true;
     use_bitbang = settings.clock < bitbang_threshold;
     current_settings = settings;
 
@@ -31,7 +49,7 @@ void SPIWrapper::beginTransaction(const SPIWrapperSettings& settings) {
         if (settings.sck_pin != PIN_SPI_SCK) {
             debugprintf("ERROR mosi pin must match builtin one\n");
         }
-        SPI.beginTransaction(SPISettings(settings.clock, settings.bitOrder, settings.dataMode));
+        hardware_settings = SPISettings(settings.clock, settings.bitOrder, settings.dataMode);
     }
 }
 
@@ -42,19 +60,66 @@ void SPIWrapper::endTransaction() {
 }
 
 void SPIWrapper::transfer16(uint16_t data) {
+    record(SPI_TRACE_WORD, data);
     if (use_bitbang) {
-        bitbangTransfer16(data);
+        if (current_settings.bitbangTransfer16) {
+            current_settings.bitbangTransfer16(data);
+        } else {
+            bitbangTransfer16(data);
+        }
     } else {
         SPI.transfer16(data);
     }
 }
 
+const SPIWrapperStats& SPIWrapper::getStats() const {
+    return stats;
+}
+
+void SPIWrapper::resetStats() {
+    stats = SPIWrapperStats();
+}
+
+void SPIWrapper::record(SPITraceEvent event, uint16_t word) {
+    if (tracing) {
+        trace[traceHead++ & (SPI_TRACE_SIZE - 1)] = {micros(), word, tracedDevice, event};
+    }
+}
+
+void SPIWrapper::traceSelect(SPIDeviceId device) {
+    tracedDevice = device;
+    record(SPI_TRACE_SELECT, 0);
+}
+
+void SPIWrapper::traceDeselect() {
+    record(SPI_TRACE_DESELECT, 0);
+}
+
+void SPIWrapper::setTracing(bool enabled) {
+    tracing = enabled;
+}
+
+void SPIWrapper::printTrace(FILE* out) {
+    static const char* devices[SPI_DEVICE__COUNT__] = {"dac", "chorus", "amp", "keybed", "leds"};
+    static const char* events[] = {"select", "word", "deselect"};
+
+    bool wasTracing = tracing;
+    tracing = false;
+    uint32_t count = traceHead < SPI_TRACE_SIZE ? traceHead : SPI_TRACE_SIZE;
+    fprintf(out, "micros,device,event,word\n");
+    for (uint32_t i = traceHead - count; i != traceHead; i++) {
+        const SPITraceEntry& e = trace[i & (SPI_TRACE_SIZE - 1)];
+        fprintf(out, "%lu,%s,%s,%u\n", (unsigned long)e.micros, devices[e.device], events[e.event], e.word);
+    }
+    tracing = wasTracing;
+}
+
 bool SPIWrapper::cpol() const {
-    return (current_settings.dataMode & 0x02);
+    return (current_settings.dataMode & SPI_MODE_CPOL);
 }
 
 bool SPIWrapper::cpha() const {
-    return (current_settings.dataMode & 0x01);
+    return (current_settings.dataMode & SPI_MODE_CPHA);
 }
 
 void SPIWrapper::delayBit() const {
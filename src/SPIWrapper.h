@@ -3,6 +3,34 @@
 #include <Arduino.h>
 #include <SPI.h>
 
+#include "BitbangSPI.h"
+
+// entries kept by the trace, a power of two
+#define SPI_TRACE_SIZE 4096
+
+// devices as named in the trace
+enum SPIDeviceId : uint8_t {
+    SPI_DEVICE_DAC,
+    SPI_DEVICE_CHORUS_DAC,
+    SPI_DEVICE_AMP,
+    SPI_DEVICE_KEYBED,
+    SPI_DEVICE_LEDS,
+    SPI_DEVICE__COUNT__,
+};
+
+enum SPITraceEvent : uint8_t {
+    SPI_TRACE_SELECT,  // cs pulled low
+    SPI_TRACE_WORD,    // transferred while selected
+    SPI_TRACE_DESELECT,
+};
+
+struct SPITraceEntry {
+    uint32_t micros;
+    uint16_t word;
+    SPIDeviceId device;
+    SPITraceEvent event;
+};
+
 class SPIWrapperSettings {
    public:
     uint32_t clock;
@@ -10,8 +38,29 @@ class SPIWrapperSettings {
     uint8_t dataMode;
     uint8_t mosi_pin;
     uint8_t sck_pin;
+    // compile time bitbang engine, see bitbangSPISettings()
+    void (*bitbangTransfer16)(uint16_t data) = nullptr;
 
     SPIWrapperSettings(uint32_t clk, uint8_t order, uint8_t mode, uint8_t mosiPin, uint8_t sckPin);
+    bool matches(const SPIWrapperSettings& other) const;
+};
+
+// settings below the bitbang threshold which shift through BitbangSPI
+template <uint32_t Clock, uint8_t BitOrder, uint8_t DataMode, uint8_t MosiPin, uint8_t SckPin>
+SPIWrapperSettings bitbangSPISettings() {
+    SPIWrapperSettings settings(Clock, BitOrder, DataMode, MosiPin, SckPin);
+    settings.bitbangTransfer16 = BitbangSPI<MosiPin, SckPin, BitOrder, DataMode, Clock>::transfer16;
+    return settings;
+}
+
+// clock of the bitbanged buses. the old loop waited 1 us per half period and
+// paid a digitalWrite per pin change on top, so it ran just under 500 kHz.
+// stays at or below that, faster clocks need checking on a scope first
+#define SPI_BITBANG_CLOCK 450000
+
+struct SPIWrapperStats {
+    uint32_t transactions = 0;
+    uint32_t reconfigurations = 0;  // the rest found the bus configured already
 };
 
 class SPIWrapper {
@@ -22,10 +71,31 @@ class SPIWrapper {
     void endTransaction();
     void transfer16(uint16_t data);
 
+    const SPIWrapperStats& getStats() const;
+    void resetStats();
+
+    // the ring of the last SPI_TRACE_SIZE entries, see test/decode_spi_trace.py
+    void traceSelect(SPIDeviceId device);
+    void traceDeselect();
+    void setTracing(bool enabled);
+    // csv, pauses tracing while printing
+    void printTrace(FILE* out = stdout);
+
    private:
     uint32_t bitbang_threshold;
     bool use_bitbang;
+    bool configured = false;
     SPIWrapperSettings current_settings;
+    SPISettings hardware_settings;
+    SPIWrapperStats stats;
+
+    SPITraceEntry trace[SPI_TRACE_SIZE];
+    uint32_t traceHead = 0;
+    volatile bool tracing = true;
+    SPIDeviceId tracedDevice = SPI_DEVICE_DAC;
+    void record(SPITraceEvent event, uint16_t word);
+
+    void configure(const SPIWrapperSettings& settings);
 
     bool cpol() const;
     bool cpha() const;
@@ -8,15 +8,20 @@ void StableTimer::begin(void (*callbackFunc)(), uint32_t intervalMicros) {
     callback = callbackFunc;
     interval = intervalMicros;
     instance = this;
-    timer.begin(onTimerStatic, interval);
+    start();
 }
 
 void StableTimer::setIntervalMicroseconds(uint32_t usec) {
+    if (usec == interval) {
+        return;
+    }
+    // takes effect after the current period, the due time follows in onTimer()
     interval = usec;
     timer.update(interval);
 }
 
 void StableTimer::start() {
+    nextDueMicros = micros() + interval;
     timer.begin(onTimerStatic, interval);
 }
 
@@ -24,32 +29,54 @@ void StableTimer::stop() {
     timer.end();
 }
 
-void StableTimer::enterCriticalSection() {
+const StableTimerStats& StableTimer::getStats() const {
+    return stats;
+}
+
+void StableTimer::resetStats() {
     noInterrupts();
-    inCritical = true;
+    stats = StableTimerStats();
     interrupts();
 }
 
-void StableTimer::exitCriticalSection() {
+void StableTimer::printStats() {
     noInterrupts();
-    inCritical = false;
-    bool runNow = missedTick;
-    missedTick = false;
+    StableTimerStats s = stats;
     interrupts();
-
-    if (runNow && callback) {
-        callback();  // run immediately after exiting
-    }
+    printf("\nclock timer: %lu interrupts, %lu ticks, %lu caught up\n",
+           (unsigned long)s.interrupts, (unsigned long)s.ticks, (unsigned long)s.catchUpTicks);
+    printf("clock timer: jitter %ld to %ld us, %.1f us mean\n",
+           (long)s.jitterMinMicros, (long)s.jitterMaxMicros,
+           s.interrupts ? (double)s.jitterAbsSumMicros / s.interrupts : 0.0);
 }
 
 void StableTimer::onTimerStatic() {
     if (instance) instance->onTimer();
 }
 
+// interrupt, the callback must only hand the tick over to the main loop
 void StableTimer::onTimer() {
-    if (inCritical) {
-        missedTick = true;
-    } else if (callback) {
-        callback();
+    uint32_t now = micros();
+    int32_t late = (int32_t)(now - nextDueMicros);
+    if (late < -(int32_t)interval) {
+        // restarted, the grid starts over
+        nextDueMicros = now;
+        late = 0;
+    }
+
+    if (stats.interrupts == 0 || late < stats.jitterMinMicros) stats.jitterMinMicros = late;
+    if (stats.interrupts == 0 || late > stats.jitterMaxMicros) stats.jitterMaxMicros = late;
+    stats.jitterAbsSumMicros += late < 0 ? -late : late;
+    stats.interrupts++;
+
+    uint32_t owed = late > 0 ? (uint32_t)late / interval : 0;
+    nextDueMicros += (owed + 1) * interval;
+    stats.ticks += owed + 1;
+    stats.catchUpTicks += owed;
+
+    if (callback) {
+        for (uint32_t i = 0; i <= owed; i++) {
+            callback();
+        }
     }
 }
@@ -3,6 +3,26 @@
 #include <Arduino.h>
 #include <IntervalTimer.h>
 
+struct StableTimerStats {
+    uint32_t interrupts = 0;
+    uint32_t ticks = 0;         // delivered, including catch-up
+    uint32_t catchUpTicks = 0;  // owed because the interrupt came a period or more late
+    // interrupt entry relative to the ideal tick time
+    int32_t jitterMinMicros = 0, jitterMaxMicros = 0;
+    uint64_t jitterAbsSumMicros = 0;
+};
+
+/**
+ * Interval timer which keeps the absolute tick grid. Every interrupt is
+ * compared with the time the tick was due, ticks owed after a late
+ * interrupt are delivered right away so the tempo does not drift.
+ *
+ * Jitter budget: all pit channels share one interrupt vector, so a tick
+ * waits for a keybed scan interrupt in progress. The longest is the row
+ * tick, which bitbangs the row select word for KEYBED_ROW_MICROS (about
+ * 36 us) before selecting column 0. Moving the row shift to the hardware
+ * spi would take it out of the budget.
+ */
 class StableTimer {
    public:
     StableTimer();
@@ -10,8 +30,10 @@ class StableTimer {
     void setIntervalMicroseconds(uint32_t usec);
     void start();
     void stop();
-    void enterCriticalSection();
-    void exitCriticalSection();
+
+    const StableTimerStats& getStats() const;
+    void resetStats();
+    void printStats();
 
    private:
     static void onTimerStatic();
@@ -19,9 +41,9 @@ class StableTimer {
 
     IntervalTimer timer;
     void (*callback)() = nullptr;
-    volatile bool inCritical = false;
-    volatile bool missedTick = false;
     uint32_t interval = 10000;
+    uint32_t nextDueMicros = 0;
+    StableTimerStats stats;
 
     static StableTimer* instance;
 };
@@ -0,0 +1,830 @@
+/**
+ * Host benchmark, built by the native environment instead of main.cpp.
+ * Runs the control loop against the hal_native shim with a scripted midi
+ * performance and prints loop throughput and the profiler stages. Models of
+ * the dac chain, the mcp4802, the pga2311 and the led shift registers listen
+ * on the pins meanwhile, their state is compared with what the firmware
+ * meant to send and their timing and bus time are printed. Then follow micro
+ * benchmarks of the voice bank and the lookup tables, a check of the frame
+ * double buffer against a preempting reader and a check of the tuning
+ * period estimator against synthetic edge streams, the keybed
+ * scan and its velocity curve against a keyboard model, the midi clock follower against a
+ * jittered clock and the bitbang waveforms against a recorded pin trace.
+ *
+ * Stage timings are host cpu time: bus delays advance the simulated clock
+ * but do not take wall time, see HalNativeStats for the time they would take.
+ *
+ * usage: program [seconds] [spi trace file]
+ *
+ * Exits with 1 if any of the checks failed, with 2 on bad arguments.
+ *
+ * The spi trace of the end of the control loop is written as csv to the
+ * trace file, see test/decode_spi_trace.py.
+ */
+#include <Arduino.h>
+#include <hal_native.h>
+#include <hal_native_devices.h>
+#include <usb_midi.h>
+
+#include "SPIBus.h"
+#include "SPIWrapper.h"
+#include "StableTimer.h"
+#include "clockfollower.h"
+#include "config.h"
+#include "dacs.h"
+#include "instrument.h"
+#include "keybed.h"
+#include "led.h"
+#include "panel.h"
+#include "period.h"
+#include "player.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "sine.h"
+#include "spline.h"
+#include "tasks.h"
+#include "utils.h"
+#include "voicebank.h"
+
+// checks which failed, the bench exits with 1 if any did
+static int failures = 0;
+
+// marker printed after a check, counted if the check failed
+static const char* check(bool ok, const char* marker) {
+    if (!ok) {
+        failures++;
+    }
+    return ok ? "" : marker;
+}
+
+// midi script
+#define SCRIPT_STEP_MILLIS 125
+#define SCRIPT_CHORD_SIZE 4
+#define SCRIPT_CLOCK_MICROS 20833  // 24 ppqn at 120 bpm
+
+static const uint8_t scriptChords[][SCRIPT_CHORD_SIZE] = {
+    {48, 55, 60, 64},
+    {45, 52, 57, 60},
+    {41, 48, 53, 57},
+    {43, 50, 55, 59},
+};
+
+#define SCRIPT_CHORD_COUNT (int)(sizeof(scriptChords) / sizeof(scriptChords[0]))
+
+// released switches read high, faders sit in the middle
+static void panel_inputs_setup() {
+    const uint8_t muxPins[] = {PIN_P_MUX_1, PIN_P_MUX_2, PIN_P_MUX_4, PIN_P_MUX_5, PIN_P_MUX_6};
+    for (uint8_t pin : muxPins) {
+        hal_native_set_digital(pin, HIGH);
+        hal_native_set_analog(pin, 512);
+    }
+    hal_native_set_digital(PIN_FTSW, HIGH);
+}
+
+struct MidiScript {
+    uint32_t lastStepMillis = 0;
+    uint32_t lastClockMicros = 0;
+    int chord = -1;
+    uint32_t messages = 0;
+
+    void push(midi::MidiType type, uint8_t data1, uint8_t data2) {
+        if (hal_native_midi_push(usbMIDI, type, data1, data2)) {
+            messages++;
+        }
+    }
+
+    void update() {
+        uint32_t now = micros();
+        if (now - lastClockMicros >= SCRIPT_CLOCK_MICROS) {
+            lastClockMicros = now;
+            push(midi::Clock, 0, 0);
+        }
+        if (chord >= 0 && millis() - lastStepMillis < SCRIPT_STEP_MILLIS) {
+            return;
+        }
+        lastStepMillis = millis();
+        if (chord >= 0) {
+            for (uint8_t note : scriptChords[chord]) {
+                push(midi::NoteOff, note, 0);
+            }
+        }
+        chord = (chord + 1) % SCRIPT_CHORD_COUNT;
+        for (uint8_t note : scriptChords[chord]) {
+            push(midi::NoteOn, note, 100);
+        }
+    }
+};
+
+// peripherals on the firmware pins, checked after the control loop
+#define DAC_CHAIN_CHIPS 8
+#define DAC_CHAIN_CHANNELS 8
+
+extern uint8_t dac_buffer[DAC_CHAIN_CHIPS * DAC_CHAIN_CHANNELS];
+
+struct DeviceModels {
+    DacChainModel dac{PIN_DAC_CS, PIN_SPI_MOSI, PIN_SPI_SCK, DAC_CHAIN_CHIPS};
+    Mcp4802Model chorus{PIN_CHORUS_DAC_CS, PIN_SPI_MOSI, PIN_SPI_SCK};
+    Pga2311Model amp{PIN_AMP_CS, PIN_SPI_MOSI, PIN_SPI_SCK};
+    ShiftRegisterModel leds{PIN_P_SR_RCLK, PIN_P_MOSI, PIN_P_SCK, 32};
+};
+
+static DeviceModels* models = nullptr;
+
+static void device_models_attach() {
+    // released like in setup() of main.cpp before the models see the pins
+    const uint8_t csPins[] = {PIN_P_SR_RCLK, PIN_CHORUS_DAC_CS, PIN_DAC_CS, PIN_AMP_CS, PIN_KYBD_CS};
+    for (uint8_t pin : csPins) {
+        digitalWrite(pin, HIGH);
+    }
+    static DeviceModels instance;
+    models = &instance;
+    hal_native_attach_device(&models->dac);
+    hal_native_attach_device(&models->chorus);
+    hal_native_attach_device(&models->amp);
+    hal_native_attach_device(&models->leds);
+}
+
+static void print_device_stats(const char* name, const SpiSlaveStats& s) {
+    printf("%-10s%8lu%9lu%8lu%8lu%8lu%12.0f%10.1f\n", name, (unsigned long)s.frames,
+           (unsigned long)s.framingErrors, (unsigned long)s.clockNotIdle, (unsigned long)s.setupViolations,
+           (unsigned long)s.holdViolations, s.busyNanos / 1000.0, s.frames ? s.busyNanos / 1000.0 / s.frames : 0.0);
+}
+
+static bool protocol_ok(const SpiSlaveStats& s) {
+    return s.frames > 0 && !s.framingErrors && !s.clockNotIdle && !s.setupViolations && !s.holdViolations;
+}
+
+// the analog state of the models against what the firmware meant to send
+static void device_models_check() {
+    leds.write();  // latest blink state
+    instr.writeAudioPath();
+    instr.writeDacs();  // latest frame
+
+    int dacMismatches = 0;
+    for (int chip = 0; chip < DAC_CHAIN_CHIPS; chip++) {
+        for (int channel = 0; channel < DAC_CHAIN_CHANNELS; channel++) {
+            if (models->dac.level(chip, channel) != dac_buffer[DAC_CHAIN_CHANNELS * chip + channel]) {
+                dacMismatches++;
+            }
+        }
+    }
+    uint32_t ledOutputs = models->leds.getOutputs();
+
+    printf("\n%-10s%8s%9s%8s%8s%8s%12s%10s\n", "device", "frames", "framing", "clock", "setup", "hold", "busy us", "us/frame");
+    print_device_stats("dac chain", models->dac.getStats());
+    print_device_stats("mcp4802", models->chorus.getStats());
+    print_device_stats("pga2311", models->amp.getStats());
+    print_device_stats("leds", models->leds.getStats());
+
+    bool ok = protocol_ok(models->dac.getStats()) && protocol_ok(models->chorus.getStats()) &&
+              protocol_ok(models->amp.getStats()) && protocol_ok(models->leds.getStats()) &&
+              dacMismatches == 0 && ledOutputs == leds.shiftRegisterWord();
+    printf("dac chain: %d of %d channels differ from dac_buffer, voice 0 amp %.2f V\n", dacMismatches,
+           DAC_CHAIN_CHIPS * DAC_CHAIN_CHANNELS, models->dac.volts(0, 5));
+    printf("chorus %.3f V / %.3f V, gain %.1f dB / %.1f dB, leds %08lx expected %08lx%s\n",
+           models->chorus.volts(0), models->chorus.volts(1), models->amp.gainDb(0), models->amp.gainDb(1),
+           (unsigned long)ledOutputs, (unsigned long)leds.shiftRegisterWord(), check(ok, "  DEVICE CHECK FAILED"));
+
+    hal_native_detach_device(&models->dac);
+    hal_native_detach_device(&models->chorus);
+    hal_native_detach_device(&models->amp);
+    hal_native_detach_device(&models->leds);
+}
+
+static void bench_control_loop(double seconds) {
+    MidiScript script;
+    uint64_t loops = 0;
+    uint32_t startMicros = micros();
+    uint32_t last = profiler_timestamp();
+    double elapsed = 0;
+
+    while (elapsed < seconds) {
+        for (int i = 0; i < 1000; i++) {
+            script.update();
+            hal_native_poll();
+            scheduler.runNext();
+            loops++;
+        }
+        // summed in batches, the nanosecond timestamp wraps every 4.29 s
+        uint32_t now = profiler_timestamp();
+        elapsed += profiler_ticks_to_micros(now - last) / 1e6;
+        last = now;
+    }
+
+    const HalNativeStats& hal = hal_native_get_stats();
+    double simulated = (micros() - startMicros) / 1e6;
+
+    printf("\ncontrol loop: %llu loops in %.2f s, %.0f loops/s, %.2f s simulated\n",
+           (unsigned long long)loops, elapsed, loops / elapsed, simulated);
+    printf("midi: %lu messages in, %lu out\n",
+           (unsigned long)script.messages, (unsigned long)usbMIDI.sent);
+    printf("hal: %llu digital writes, %llu spi transfers, %llu us bus delays, %llu timer interrupts\n",
+           (unsigned long long)hal.digitalWrites, (unsigned long long)hal.spiTransfers,
+           (unsigned long long)hal.delayMicros, (unsigned long long)hal.timerCallbacks);
+
+    profiler_print();
+    scheduler.print();
+    dacs_print_stats();
+    spiBus.printStats();
+    clockTimer.printStats();
+    player.printClockStats();
+    device_models_check();
+}
+
+// keeps results alive without affecting the timed loops
+static volatile float sink;
+
+template <int N>
+static void bench_voicebank(int frames) {
+    VoiceBank<N> bank;
+    LfoBank<N> lfos;
+    PatchParams params = {};
+    params.attack = 0.01;
+    params.decay = 0.5;
+    params.sustain = 0.7;
+    params.release = 0.3;
+    params.lfoFrequency = 5;
+    params.lfoDelay = 0.2;
+    params.vibrato = 0.3;
+    params.cutoff = 40;
+    params.cutoffKeytrack = 1;
+    params.cutoffEnvelope = 30;
+    params.pulseWidth = 0.5;
+    for (int i = 0; i < N; i++) {
+        bank.note[i] = 36 + i;
+        lfos.frequency[i] = params.lfoFrequency;
+        lfos.drift[i] = 0.01f * i;
+        lfos.delay[i] = params.lfoDelay;
+    }
+
+    uint32_t start = profiler_timestamp();
+    for (int frame = 0; frame < frames; frame++) {
+        // retrigger a voice every few frames to exercise the envelope stages
+        int voice = frame % N;
+        bank.gate[voice] = (frame / N) & 1;
+        lfos.gate[voice] = bank.gate[voice];
+        lfos.update(0.001f);
+        bank.update(0.001f, params, lfos.level, 0, 0, 0);
+    }
+    float micros = profiler_ticks_to_micros(profiler_timestamp() - start);
+    sink = bank.outCutoff[N - 1];
+
+    printf("voice bank %2d voices: %8.1f ns per frame, %6.1f ns per voice\n",
+           N, 1000.0f * micros / frames, 1000.0f * micros / frames / N);
+}
+
+template <typename F>
+static void bench_function(const char* name, int iterations, F f) {
+    float sum = 0;
+    uint32_t start = profiler_timestamp();
+    for (int i = 0; i < iterations; i++) {
+        sum += f(i);
+    }
+    float micros = profiler_ticks_to_micros(profiler_timestamp() - start);
+    sink = sum;
+    printf("%-24s %8.2f ns per call\n", name, 1000.0f * micros / iterations);
+}
+
+static void bench_tables() {
+    const int iterations = 1000000;
+    printf("\n");
+    bench_function("faderLog", iterations, [](int i) { return faderLog(i & 1023); });
+    bench_function("sinePhase table", iterations, [](int i) { return sinePhase((uint32_t)i * 2654435761u); });
+    bench_function("sinf", iterations, [](int i) { return sinf(((uint32_t)i * 2654435761u) * (float)(M_TWOPI / 4294967296.0)); });
+
+    // voice 0 pitch from test/10_tuning_samples_1000ms_timespan.csv
+    static float x[] = {22.32, 32.34, 41.50, 51.12, 60.62, 70.00, 79.56, 89.06, 98.66, 108.25};
+    static float y[] = {15, 25, 35, 45, 55, 65, 75, 85, 95, 105};
+    static TuningSpline spline;
+    spline_fit(x, y, 10, spline);
+    bench_function("spline_evaluate", iterations, [](int i) { return spline_evaluate(spline, (i & 4095) * (128.0f / 4096)); });
+    bench_function("spline_fit", iterations / 1000, [](int) { return (float)spline_fit(x, y, 10, spline); });
+}
+
+#define SWAP_TEST_FRAMES 64
+#define SWAP_TEST_WORDS 16
+
+// every word of a frame holds the sequence number it was published as
+struct SwapTestFrame {
+    uint32_t words[SWAP_TEST_WORDS];
+};
+
+struct SwapTestReader {
+    uint32_t reads = 0, torn = 0, stale = 0, fresh = 0;
+    uint32_t lastSequence = 0;
+
+    // a consumer preempting the producer reads the whole front frame
+    void read(const DoubleBuffer<SwapTestFrame>& buffer) {
+        uint32_t sequence = buffer.getSequence();
+        const SwapTestFrame& frame = buffer.acquire();
+        reads++;
+        for (uint32_t word : frame.words) {
+            if (word != frame.words[0]) {
+                torn++;
+                return;
+            }
+        }
+        if (frame.words[0] != sequence) {
+            stale++;
+        }
+        if (sequence != lastSequence) {
+            fresh++;
+            lastSequence = sequence;
+        }
+    }
+};
+
+// the consumer preempts the producer at every point of filling and publishing a frame
+static void bench_double_buffer() {
+    DoubleBuffer<SwapTestFrame> buffer;
+    SwapTestReader reader;
+    for (uint32_t published = 1; published <= SWAP_TEST_FRAMES; published++) {
+        SwapTestFrame& back = buffer.back();
+        for (uint32_t& word : back.words) {
+            reader.read(buffer);
+            word = published;
+        }
+        reader.read(buffer);
+        buffer.publish();
+        reader.read(buffer);
+    }
+    printf("\ndouble buffer: %lu frames, %lu reads, %lu torn, %lu stale, %lu fresh frames seen%s\n",
+           (unsigned long)SWAP_TEST_FRAMES, (unsigned long)reader.reads, (unsigned long)reader.torn,
+           (unsigned long)reader.stale, (unsigned long)reader.fresh,
+           check(!reader.torn && !reader.stale && reader.fresh == SWAP_TEST_FRAMES, "  SWAP ERROR"));
+}
+
+// loopback frequencies of voice 0 from test/10_tuning_samples_1000ms_timespan.csv
+static const float periodTestFrequencies[] = {
+    59.34505, 313.2711, 1619.539, 8492.528,    // pitch
+    42.24484, 259.5490, 1612.939, 9730.800,    // cutoff
+};
+
+#define PERIOD_TEST_JITTER_MICROS 1.0  // interrupt latency, standard deviation
+#define PERIOD_TEST_MISSED 0.01        // fraction of edges lost
+#define PERIOD_TEST_SPURIOUS 0.005     // fraction of periods with an extra glitch edge
+#define PERIOD_TEST_TOLERANCE_CENTS 1.0
+#define PERIOD_TEST_MAX_MILLIS 1000
+
+static uint32_t randomState = 0x12345678;
+
+static float random_uniform() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (randomState >> 8) / 16777216.0f;
+}
+
+static float random_normal() {
+    float u = random_uniform() + 1e-7f;
+    return sqrtf(-2 * logf(u)) * cosf(M_TWOPI * random_uniform());
+}
+
+// edges are queued as the interrupt would and processed once per millisecond
+static void bench_period_estimator() {
+    double ticksPerMicro = 1e6 / profiler_ticks_to_micros(1000000);
+    PeriodEstimator estimator;
+
+    printf("\n%10s%12s%10s%10s%8s%8s%8s\n", "freq", "estimate", "error", "+-cents", "edges", "reject", "ms");
+    for (float freq : periodTestFrequencies) {
+        estimator.begin(PERIOD_TEST_TOLERANCE_CENTS);
+        double periodMicros = 1e6 / freq;
+        double edgeMicros = 1000 * random_uniform();  // arbitrary phase
+        int millis = 0;
+
+        for (; millis < PERIOD_TEST_MAX_MILLIS; millis++) {
+            while (edgeMicros < (millis + 1) * 1000.0) {
+                double jitter = PERIOD_TEST_JITTER_MICROS * random_normal();
+                if (random_uniform() >= PERIOD_TEST_MISSED) {
+                    estimator.addEdge((uint32_t)((edgeMicros + jitter) * ticksPerMicro));
+                }
+                if (random_uniform() < PERIOD_TEST_SPURIOUS) {
+                    double glitch = edgeMicros + random_uniform() * periodMicros;
+                    estimator.addEdge((uint32_t)(glitch * ticksPerMicro));
+                }
+                edgeMicros += periodMicros;
+            }
+            if (estimator.process()) {
+                break;
+            }
+        }
+
+        PeriodEstimate e = estimator.getEstimate();
+        float errorCents = 1200 * log2f(e.frequency / freq);
+        printf("%10.2f%12.3f%10.3f%10.3f%8d%8d%8d%s\n",
+               freq, e.frequency, errorCents, e.cents, e.edges, e.rejected, millis + 1,
+               check(fabsf(errorCents) <= e.cents, "  outside interval"));
+    }
+}
+
+#define MIDI_CLOCK_JITTER_MICROS 1000  // transport jitter, standard deviation
+#define MIDI_CLOCK_TICKS 2400            // per tempo
+#define MIDI_CLOCK_STEP_TICKS 6          // 16th notes
+
+static const float midiClockTempos[] = {120, 90, 174};
+
+struct StepTimes {
+    uint32_t last = 0;
+    int steps = 0;
+    double sum = 0, sumSquares = 0;
+
+    void add(uint32_t t, float stepMicros) {
+        if (steps++ > 0) {
+            double error = (double)(uint32_t)(t - last) - stepMicros;
+            sum += error;
+            sumSquares += error * error;
+        }
+        last = t;
+    }
+
+    double deviation() const {
+        int n = std::max(steps - 1, 1);
+        return sqrt(std::max(sumSquares / n - (sum / n) * (sum / n), 0.0));
+    }
+};
+
+// jittered clock bytes, read and polled every keybed period like in the firmware
+static void bench_midi_clock() {
+    printf("\n%8s%14s%14s%10s%10s\n", "bpm", "raw step sd", "pll step sd", "lock ms", "tempo");
+    ClockFollower follower;
+    double t = 0;
+    uint32_t now = 0;
+    for (float bpm : midiClockTempos) {
+        double tickMicros = 60e6 / (24 * bpm);
+        StepTimes raw, smoothed;
+        uint32_t received = 0, played = 0;
+        int32_t lockMicros = -1;
+        uint32_t start = now;
+
+        for (int tick = 0; tick < MIDI_CLOCK_TICKS; tick++) {
+            t += tickMicros;
+            uint32_t arrival = (uint32_t)(t + fabs(MIDI_CLOCK_JITTER_MICROS * random_normal()));
+            while ((int32_t)(now - arrival) < 0) {
+                now += KEYBED_PERIOD_MICROS;
+                while (follower.poll(now)) {
+                    if (++played % MIDI_CLOCK_STEP_TICKS == 0) {
+                        smoothed.add(now, tickMicros * MIDI_CLOCK_STEP_TICKS);
+                    }
+                }
+                // locked on the new tempo
+                if (lockMicros < 0 && follower.isLocked() && fabsf(follower.getStatus().bpm - bpm) < 0.01f * bpm) {
+                    lockMicros = now - start;
+                }
+            }
+            follower.input(now);
+            if (++received % MIDI_CLOCK_STEP_TICKS == 0) {
+                raw.add(now, tickMicros * MIDI_CLOCK_STEP_TICKS);
+            }
+        }
+
+        ClockFollowerStatus status = follower.getStatus();
+        printf("%8.0f%11.0f us%11.0f us%10.0f%10.1f%s\n", bpm, raw.deviation(), smoothed.deviation(),
+               lockMicros / 1000.0, status.bpm, check(status.locked && smoothed.deviation() < raw.deviation(), "  NOT SMOOTHED"));
+    }
+}
+
+#define WAVEFORM_CLOCK 500000
+#define WAVEFORM_EDGES 512
+
+static const uint16_t waveformWords[] = {0xa5c3, 0x0001, 0x8000, 0xffff};
+static HalNativeEdge waveformEdges[WAVEFORM_EDGES];
+
+// records the pins while shifting out the words and replays them like a slave would
+template <uint8_t BitOrder, uint8_t DataMode>
+static void check_bitbang_waveform(const char* name) {
+    using Engine = BitbangSPI<PIN_P_MOSI, PIN_P_SCK, BitOrder, DataMode, WAVEFORM_CLOCK>;
+    const int words = sizeof(waveformWords) / sizeof(waveformWords[0]);
+    const uint64_t half = Engine::HALF_PERIOD_NANOS;
+
+    digitalWrite(PIN_P_SCK, Engine::CPOL);
+    digitalWrite(PIN_P_MOSI, LOW);
+    hal_native_pause_wall_clock(true);
+    hal_native_record_edges(waveformEdges, WAVEFORM_EDGES);
+    uint64_t start = hal_native_nanos();
+    for (uint16_t word : waveformWords) {
+        Engine::transfer16(word);
+    }
+    uint64_t duration = hal_native_nanos() - start;
+    int count = hal_native_recorded_edges();
+    hal_native_record_edges(nullptr, 0);
+    hal_native_pause_wall_clock(false);
+
+    bool mosi = LOW, sck = Engine::CPOL;
+    uint64_t lastMosi = start, minSetup = UINT64_MAX;
+    uint64_t firstSck = start + (Engine::CPHA ? 0 : half);
+    uint16_t decoded[words] = {};
+    int bits = 0, sckEdges = 0, mosiEdges = 0, misplaced = 0;
+    for (int i = 0; i < count; i++) {
+        const HalNativeEdge& edge = waveformEdges[i];
+        if (edge.pin == PIN_P_MOSI) {
+            mosi = edge.level;
+            lastMosi = edge.nanos;
+            mosiEdges++;
+            continue;
+        }
+        if (edge.pin != PIN_P_SCK) {
+            continue;
+        }
+        // every clock edge half a period after the previous one
+        if (edge.nanos != firstSck + sckEdges * half) {
+            misplaced++;
+        }
+        sckEdges++;
+        sck = edge.level;
+        bool leading = sck != Engine::CPOL;
+        if (leading == Engine::CPHA || bits >= 16 * words) {
+            continue;
+        }
+        minSetup = std::min(minSetup, edge.nanos - lastMosi);
+        int word = bits / 16, bit = bits % 16;
+        decoded[word] |= mosi << (BitOrder == MSBFIRST ? 15 - bit : bit);
+        bits++;
+    }
+
+    bool ok = sckEdges == 32 * words && misplaced == 0 && minSetup >= half && sck == Engine::CPOL &&
+              memcmp(decoded, waveformWords, sizeof(decoded)) == 0;
+    printf("%-14s%8d%8d%10d%10.0f%12.1f  %s\n", name, sckEdges, mosiEdges, misplaced,
+           minSetup == UINT64_MAX ? 0.0 : (double)minSetup, duration / 1000.0 / words, ok ? "ok" : check(false, "WAVEFORM ERROR"));
+}
+
+static void bench_bitbang_waveform() {
+    printf("\n%-14s%8s%8s%10s%10s%12s\n", "bitbang", "sck", "mosi", "misplaced", "setup ns", "us/word");
+    check_bitbang_waveform<MSBFIRST, SPI_MODE0>("mode 0 msb");
+    check_bitbang_waveform<MSBFIRST, SPI_MODE1>("mode 1 msb");
+    check_bitbang_waveform<MSBFIRST, SPI_MODE2>("mode 2 msb");
+    check_bitbang_waveform<MSBFIRST, SPI_MODE3>("mode 3 msb");
+    check_bitbang_waveform<LSBFIRST, SPI_MODE0>("mode 0 lsb");
+}
+
+// keyboard matrix model, follows the bitbanged row shift register and the column muxes
+extern int16_t keyMatrices[2][8][8];
+extern int keyMatrixInputs[2];
+
+#define GLISS_STEP_MICROS 1000    // next key
+#define GLISS_TRAVEL_MICROS 4000  // first to second contact of the lowest key
+#define GLISS_TRAVEL_STEP 150     // longer for every higher key
+#define GLISS_HOLD_MICROS 30000
+#define GLISS_COUNT 20
+#define GLISS_CLUSTERS 5          // all keys at once, after the glissandi
+#define GLISS_PAUSE_MICROS 100000
+
+static MatrixLevel keyLevels[NUM_KEYS];
+static uint16_t keyShift = 0, keyRows = 0;
+
+static void keybed_model_inputs() {
+    int column = (hal_native_get_digital(PIN_KYBD_MUX_A) ? 4 : 0) |
+                 (hal_native_get_digital(PIN_KYBD_MUX_B) ? 2 : 0) |
+                 (hal_native_get_digital(PIN_KYBD_MUX_C) ? 1 : 0);
+    uint8_t rows = (keyRows | keyRows >> 8) & 0xff;
+    for (int bank = 0; bank < 2; bank++) {
+        bool closed = false;
+        for (int row = 0; row < 8; row++) {
+            int button = keyMatrices[bank][row][column];
+            if (!(rows & (1 << row)) || button < 0) {
+                continue;
+            }
+            closed |= button >= 100 ? keyLevels[button - 100] == MatrixLevel::BOTH
+                                    : keyLevels[button] != MatrixLevel::OPEN;
+        }
+        hal_native_set_digital(keyMatrixInputs[bank], closed);
+    }
+}
+
+static void keybed_model_write(uint8_t pin, uint8_t value) {
+    if (pin == PIN_SPI_SCK && value) {
+        keyShift = (keyShift << 1) | hal_native_get_digital(PIN_SPI_MOSI);
+    } else if (pin == PIN_KYBD_CS && value) {
+        keyRows = keyShift;
+        keybed_model_inputs();
+    } else if (pin == PIN_KYBD_MUX_A || pin == PIN_KYBD_MUX_B || pin == PIN_KYBD_MUX_C) {
+        keybed_model_inputs();
+    }
+}
+
+// press start of every key in the script, relative to the start
+static uint32_t gliss_press_time(int gliss, int key) {
+    if (gliss < GLISS_COUNT) {
+        int position = gliss % 2 ? NUM_KEYS - 1 - key : key;
+        uint32_t length = NUM_KEYS * GLISS_STEP_MICROS + GLISS_HOLD_MICROS + GLISS_PAUSE_MICROS;
+        return gliss * length + position * GLISS_STEP_MICROS;
+    }
+    uint32_t start = GLISS_COUNT * (NUM_KEYS * GLISS_STEP_MICROS + GLISS_HOLD_MICROS + GLISS_PAUSE_MICROS);
+    return start + (gliss - GLISS_COUNT) * (GLISS_HOLD_MICROS + GLISS_PAUSE_MICROS);
+}
+
+static uint32_t gliss_travel(int key) {
+    return GLISS_TRAVEL_MICROS + key * GLISS_TRAVEL_STEP;
+}
+
+// calibrated curve, log of the travel time between the fastest and the slowest strike
+static double ideal_velocity(double travelMicros) {
+    double position = log(KEYBED_TRAVEL_SLOWEST_MICROS / travelMicros) /
+                      log((double)KEYBED_TRAVEL_SLOWEST_MICROS / KEYBED_TRAVEL_FASTEST_MICROS);
+    return std::min(std::max(1 + 126 * position, 1.0), 127.0);
+}
+
+static struct {
+    uint32_t downs, ups, maxPending;
+    uint64_t latencySum;
+    uint32_t latencyMax;
+    int velocityErrorMax;
+    uint32_t bothMicros[NUM_KEYS];  // when the second contact closed in the script
+    bool pending[NUM_KEYS];
+} glissStats;
+
+static void gliss_key_down(int key, int velocity) {
+    // with the footswitch held the key down is delayed by the retrigger time
+    uint32_t latency = micros() - glissStats.bothMicros[key] - KEYBED_RETRIGGER_MICROS;
+    glissStats.latencySum += latency;
+    glissStats.latencyMax = std::max(glissStats.latencyMax, latency);
+    int expected = (int)(ideal_velocity(gliss_travel(key)) + 0.5);
+    glissStats.velocityErrorMax = std::max(glissStats.velocityErrorMax, abs(velocity - expected));
+    glissStats.pending[key] = false;
+    glissStats.downs++;
+}
+
+static void gliss_key_up(int key) {
+    glissStats.pending[key] = true;
+    glissStats.ups++;
+}
+
+// footswitch held, so every press is a key up followed by a delayed key down
+static void bench_keybed_glissando() {
+    Keybed keybed;
+    keybed.init();
+    keybed.setHandleKeyDown(gliss_key_down);
+    keybed.setHandleKeyUp(gliss_key_up);
+    glissStats = {};
+    hal_native_set_write_hook(keybed_model_write);
+    hal_native_set_digital(PIN_FTSW, LOW);
+
+    const int glissandi = GLISS_COUNT + GLISS_CLUSTERS;
+    uint32_t end = gliss_press_time(glissandi, 0);
+    uint32_t start = micros();
+    uint32_t lastUpdate = start;
+    uint64_t updates = 0, updateTicks = 0;
+
+    // the scan interrupt runs from the simulated clock, update() at the task rate
+    for (uint32_t t = 0; t < end + 2 * KEYBED_RETRIGGER_MICROS; t = micros() - start) {
+        for (int key = 0; key < NUM_KEYS; key++) {
+            MatrixLevel level = MatrixLevel::OPEN;
+            for (int gliss = 0; gliss < glissandi; gliss++) {
+                uint32_t press = gliss < GLISS_COUNT ? gliss_press_time(gliss, key) : gliss_press_time(gliss, 0);
+                if (t >= press && t < press + GLISS_HOLD_MICROS) {
+                    level = t >= press + gliss_travel(key) ? MatrixLevel::BOTH : MatrixLevel::FIRST;
+                }
+            }
+            if (level == MatrixLevel::BOTH && keyLevels[key] != MatrixLevel::BOTH) {
+                glissStats.bothMicros[key] = micros();
+            }
+            keyLevels[key] = level;
+        }
+        hal_native_advance(KEYBED_TICK_MICROS);
+        if (micros() - lastUpdate < KEYBED_PERIOD_MICROS) {
+            continue;
+        }
+        lastUpdate = micros();
+
+        uint32_t before = profiler_timestamp();
+        keybed.update();
+        updateTicks += profiler_timestamp() - before;
+        updates++;
+
+        uint32_t pending = 0;
+        for (bool p : glissStats.pending) {
+            pending += p;
+        }
+        glissStats.maxPending = std::max(glissStats.maxPending, pending);
+    }
+
+    // releasing the footswitch ends every sustained key
+    uint32_t sustainedUps = glissStats.ups;
+    hal_native_set_digital(PIN_FTSW, HIGH);
+    keybed.update();
+    sustainedUps = glissStats.ups - sustainedUps;
+    keybed.end();
+    hal_native_set_write_hook(nullptr);
+
+    uint32_t presses = GLISS_COUNT * NUM_KEYS + GLISS_CLUSTERS * NUM_KEYS;
+    printf("\nkeybed glissandi: %lu presses, %lu key ups, %lu key downs, %lu pending at most, %lu key ups on footswitch release%s\n",
+           (unsigned long)presses, (unsigned long)glissStats.ups, (unsigned long)glissStats.downs,
+           (unsigned long)glissStats.maxPending, (unsigned long)sustainedUps,
+           check(glissStats.downs == presses && glissStats.ups == presses + sustainedUps && sustainedUps == NUM_KEYS, "  MISSED KEYS"));
+    printf("keybed latency: %.0f us mean, %lu us max, velocity off by %d at most, update %.2f us host time\n",
+           glissStats.latencySum / (double)std::max<uint32_t>(glissStats.downs, 1), (unsigned long)glissStats.latencyMax,
+           glissStats.velocityErrorMax, profiler_ticks_to_micros(updateTicks) / (double)updates);
+}
+
+#define VELOCITY_STROKES 48
+#define VELOCITY_FASTEST_MICROS 1000   // beyond the calibrated range on both ends
+#define VELOCITY_SLOWEST_MICROS 200000
+#define VELOCITY_HOLD_MICROS 20000
+
+static int strokeVelocity;
+
+static void stroke_key_down(int, int velocity) {
+    strokeVelocity = velocity;
+}
+
+// single strikes with log spaced travel times, each one scanned from the interrupt
+static void bench_keybed_velocity() {
+    Keybed keybed;
+    keybed.init();
+    keybed.setHandleKeyDown(stroke_key_down);
+    hal_native_set_write_hook(keybed_model_write);
+    hal_native_set_digital(PIN_FTSW, HIGH);
+
+    int outside = 0, distinct = 0, lastVelocity = -1, saturated = 0;
+    double errorMax = 0;
+    for (int stroke = 0; stroke < VELOCITY_STROKES; stroke++) {
+        double travel = VELOCITY_FASTEST_MICROS *
+                        pow((double)VELOCITY_SLOWEST_MICROS / VELOCITY_FASTEST_MICROS, stroke / (VELOCITY_STROKES - 1.0));
+        int key = (stroke * 7) % NUM_KEYS;
+        strokeVelocity = -1;
+
+        // random phase against the scan
+        hal_native_advance(KEYBED_SCAN_MICROS * random_uniform());
+        uint32_t start = micros();
+        uint32_t lastUpdate = start;
+        for (uint32_t t = 0; t < travel + VELOCITY_HOLD_MICROS; t = micros() - start) {
+            keyLevels[key] = t >= travel ? MatrixLevel::BOTH : MatrixLevel::FIRST;
+            hal_native_advance(KEYBED_TICK_MICROS);
+            if (micros() - lastUpdate >= KEYBED_PERIOD_MICROS) {
+                lastUpdate = micros();
+                keybed.update();
+            }
+        }
+        keyLevels[key] = MatrixLevel::OPEN;
+        hal_native_advance(2 * KEYBED_SCAN_MICROS);
+        keybed.update();
+
+        // both contacts are sampled once per scan, so the travel is known to a scan period
+        double lowest = ideal_velocity(travel + KEYBED_SCAN_MICROS);
+        double highest = ideal_velocity(std::max(travel - KEYBED_SCAN_MICROS, 1.0));
+        if (strokeVelocity < lowest - 1 || strokeVelocity > highest + 1) {
+            outside++;
+        }
+        errorMax = std::max(errorMax, fabs(strokeVelocity - ideal_velocity(travel)));
+        saturated += strokeVelocity == 127 && travel > KEYBED_TRAVEL_FASTEST_MICROS + KEYBED_SCAN_MICROS;
+        distinct += strokeVelocity != lastVelocity;
+        lastVelocity = strokeVelocity;
+    }
+    keybed.end();
+    hal_native_set_write_hook(nullptr);
+
+    printf("keybed velocity: %d strokes %.1f to %.1f ms, %d velocities, off by %.1f at most, %d outside a scan period, %d saturated%s\n",
+           VELOCITY_STROKES, VELOCITY_FASTEST_MICROS / 1000.0, VELOCITY_SLOWEST_MICROS / 1000.0, distinct, errorMax,
+           outside, saturated, check(!outside && !saturated, "  VELOCITY ERROR"));
+}
+
+int main(int argc, char** argv) {
+    double seconds = 2.0;
+    if (argc > 1) {
+        char* end;
+        seconds = strtod(argv[1], &end);
+        if (end == argv[1] || *end != '\0' || !(seconds > 0)) {
+            printf("usage: %s [seconds] [spi trace file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    panel_inputs_setup();
+    device_models_attach();
+    player.init();
+
+    instr.getPatch().faders[FD_CUTOFF] = 700;
+    instr.getPatch().faders[FD_ATTACK] = 200;
+    instr.getPatch().faders[FD_RELEASE] = 500;
+    instr.getPatch().faders[FD_SUSTAIN] = 800;
+
+    scheduler_setup();
+
+    bench_control_loop(seconds);
+    if (argc > 2) {
+        FILE* trace = fopen(argv[2], "w");
+        if (trace) {
+            spiWrapper.printTrace(trace);
+            fclose(trace);
+        } else {
+            printf("cannot write %s\n", argv[2]);
+        }
+    }
+
+    printf("\n");
+    bench_voicebank<8>(200000);
+    bench_voicebank<16>(200000);
+    bench_voicebank<32>(200000);
+
+    bench_tables();
+    bench_double_buffer();
+    bench_period_estimator();
+    bench_keybed_glissando();
+    bench_keybed_velocity();
+    bench_midi_clock();
+    bench_bitbang_waveform();
+
+    if (failures) {
+        printf("\n%d checks failed\n", failures);
+    }
+    return failures ? 1 : 0;
+}
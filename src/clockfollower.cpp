@@ -0,0 +1,112 @@
+#include "clockfollower.h"
+
+#include <cmath>
+
+void ClockFollower::setBandwidth(float phaseGain) {
+    bandwidth = phaseGain;
+}
+
+void ClockFollower::reset() {
+    float keep = bandwidth;
+    uint32_t keepRelocks = relocks;
+    *this = ClockFollower();
+    bandwidth = keep;
+    relocks = keepRelocks;
+}
+
+void ClockFollower::unlock() {
+    if (locked) {
+        relocks++;
+    }
+    locked = false;
+    lockTicks = 0;
+}
+
+void ClockFollower::input(uint32_t now) {
+    uint32_t interval = now - lastArrival;
+    lastArrival = now;
+    received++;
+    if (received == 1) {
+        estimate = now;
+        return;
+    }
+    if (period == 0) {
+        period = interval;
+        estimate = now;
+        return;
+    }
+
+    uint32_t predicted = estimate + (uint32_t)lroundf(period);
+    float error = (int32_t)(now - predicted);
+    if (fabsf(error) > CLOCK_TEMPO_CHANGE * period) {
+        if (++outliers < CLOCK_TEMPO_CHANGE_TICKS) {
+            // coast on the prediction
+            estimate = predicted;
+            return;
+        }
+        // new tempo, start over from the last interval
+        unlock();
+        outliers = 0;
+        period = interval;
+        estimate = now;
+        errorAverage = 0;
+        return;
+    }
+    outliers = 0;
+
+    float alpha = locked ? bandwidth : CLOCK_ACQUIRE_BANDWIDTH;
+    float beta = alpha * alpha / (2 - alpha);
+    estimate = predicted + (int32_t)lroundf(alpha * error);
+    period += beta * error;
+    errorAverage += (fabsf(error) - errorAverage) * CLOCK_ERROR_SMOOTHING;
+
+    if (!locked) {
+        if (++lockTicks >= CLOCK_LOCK_TICKS && errorAverage < CLOCK_LOCK_ERROR * period) {
+            locked = true;
+        }
+    } else if (errorAverage > CLOCK_UNLOCK_ERROR * period) {
+        unlock();
+    }
+}
+
+bool ClockFollower::poll(uint32_t now) {
+    if (emitted + 1 < received) {
+        // behind by more than the last tick
+        emitted++;
+        return true;
+    }
+    if (!locked) {
+        if (emitted < received) {
+            emitted++;
+            return true;
+        }
+        return false;
+    }
+    if ((int32_t)(now - lastArrival) > CLOCK_DROPOUT_PERIODS * period) {
+        unlock();
+        return false;
+    }
+    if (emitted > received) {
+        return false;
+    }
+    // the last received tick on the smoothed grid, or the one after it
+    uint32_t due = estimate + (emitted + 1 - received) * (uint32_t)lroundf(period);
+    if ((int32_t)(now - due) >= 0) {
+        emitted++;
+        return true;
+    }
+    return false;
+}
+
+bool ClockFollower::isLocked() const {
+    return locked;
+}
+
+ClockFollowerStatus ClockFollower::getStatus() const {
+    return {
+        locked,
+        period > 0 ? 60e6f / (24 * period) : 0,
+        errorAverage,
+        relocks,
+    };
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+
+// phase gain once locked, the period gain follows as a^2 / (2 - a)
+#define CLOCK_FOLLOWER_BANDWIDTH 0.1f
+// phase gain while acquiring
+#define CLOCK_ACQUIRE_BANDWIDTH 0.5f
+// smoothing of the mean phase error
+#define CLOCK_ERROR_SMOOTHING 0.1f
+// mean phase error relative to the period to lock and to lose lock
+#define CLOCK_LOCK_ERROR 0.15f
+#define CLOCK_UNLOCK_ERROR 0.3f
+#define CLOCK_LOCK_TICKS 12
+// ticks further off than this are ignored, a few in a row mean a new tempo
+#define CLOCK_TEMPO_CHANGE 0.25f
+#define CLOCK_TEMPO_CHANGE_TICKS 3
+// no tick for this many periods and the follower stops running ahead
+#define CLOCK_DROPOUT_PERIODS 4
+
+struct ClockFollowerStatus {
+    bool locked;
+    float bpm;          // 24 ppqn, 0 until two ticks arrived
+    float errorMicros;  // mean absolute phase error of the incoming ticks
+    uint32_t relocks;   // tempo changes and dropouts
+};
+
+/**
+ * Phase locked follower of an external 24 ppqn clock. Incoming ticks are
+ * compared with the predicted tick time, an alpha beta loop corrects phase
+ * and period by a fraction of the error. The local ticks are played on the
+ * smoothed grid and may run one tick ahead of the input, so transport jitter
+ * is filtered out of the step timing. Until locked every incoming tick is
+ * passed straight through.
+ *
+ * Timestamps are micros(), poll() is called often and returns true for
+ * every local tick which is due.
+ */
+class ClockFollower {
+    float bandwidth = CLOCK_FOLLOWER_BANDWIDTH;
+    bool locked = false;
+
+    uint32_t received = 0, emitted = 0;
+    uint32_t lastArrival = 0;
+    uint32_t estimate = 0;  // smoothed time of the last received tick
+    float period = 0;       // micros per tick
+    float errorAverage = 0;
+    int outliers = 0;
+    int lockTicks = 0;
+    uint32_t relocks = 0;
+
+    void unlock();
+
+   public:
+    void setBandwidth(float phaseGain);
+    void reset();
+    void input(uint32_t now);
+    bool poll(uint32_t now);
+
+    bool isLocked() const;
+    ClockFollowerStatus getStatus() const;
+};
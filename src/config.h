@@ -56,14 +56,6 @@ extern SPIWrapperSettings keyboardSPISettings;
 
 extern StableTimer clockTimer;
 
-inline void enterCritical() {
-    clockTimer.enterCriticalSection();
-}
-
-inline void exitCritical() {
-    clockTimer.exitCriticalSection();
-}
-
 #if 0
 #define debugprintf printf
 #else
@@ -2,9 +2,10 @@
 
 #include <Arduino.h>
 
-#include "SPIWrapper.h"
+#include "SPIBus.h"
 #include "config.h"
 #include "instrument.h"
+#include "profiler.h"
 #include "utils.h"
 
 #define DAC_CHANNEL_COUNT 8
@@ -19,6 +20,12 @@
 #define DAC_CH_H 7
 
 uint8_t dac_buffer[DAC_CHANNEL_COUNT * DAC_COUNT];
+// contents of the dacs after the last transfer
+static uint8_t sent_dac_buffer[DAC_CHANNEL_COUNT * DAC_COUNT];
+static bool force_full_frame = true;
+static uint32_t frames_since_full = 0;
+// newest frame which is completely on the dacs
+static uint32_t sent_sequence = 0;
 
 static uint8_t float_to_char(float t) {
     if (t < 0.0) t = 0.0;
@@ -34,37 +41,85 @@ static uint16_t semis_to_short(float semis) {
     return (uint16_t)steps;
 }
 
-static float apply_correction(float x, TuningCorrection* corr) {
-    float a = corr->parabolic[0];
+static float apply_correction(float x, const TuningCorrection* corr) {
+    if (spline_is_fitted(corr->spline)) {
+        return spline_evaluate(corr->spline, x) + corr->offset;
+    }
+    float a = corr->parabolic[0] + corr->offset;
     float b = corr->parabolic[1];
     float c = corr->parabolic[2];
     return a + x * (b + x * c);
 }
 
+void dacs_compile_correction(const TuningCorrection& corr, DacCodeTable& table) {
+    for (int i = 0; i < DAC_TABLE_SIZE; i++) {
+        float semis = DAC_TABLE_MIN_SEMIS + (float)i / DAC_TABLE_STEPS_PER_SEMI;
+        table.codes[i] = semis_to_short(apply_correction(semis, &corr));
+    }
+}
+
+// interpolates between table entries, extrapolates the end segments beyond the table
+static uint16_t lookup_code(const DacCodeTable& table, float semis) {
+    float position = (semis - DAC_TABLE_MIN_SEMIS) * DAC_TABLE_STEPS_PER_SEMI;
+    int i = (int)position;
+    if (position < 0) i = 0;
+    if (i > DAC_TABLE_SIZE - 2) i = DAC_TABLE_SIZE - 2;
+    float fraction = position - i;
+    int lower = table.codes[i];
+    int upper = table.codes[i + 1];
+    int code = lower + (int)(fraction * (upper - lower));
+    if (code < 0) code = 0;
+    if (code > 65535) code = 65535;
+    return (uint16_t)code;
+}
+
 // check
 #define DAC_CS_DELAY_MICROS 20
+// resend everything once in a while in case a transfer got corrupted
+#define DAC_FULL_REFRESH_FRAMES 500
+// bytes shifted through the daisy chain for one channel
+#define DAC_CHANNEL_BYTES (2 * DAC_COUNT)
+
+static DacStats init_stats() {
+    DacStats s;
+    s.channelMicros = (DAC_COUNT + 2) * DAC_CS_DELAY_MICROS;  // estimate until measured
+    return s;
+}
+
+static DacStats stats = init_stats();
+
+// one transaction per channel, each dac of the chain gets a word
+static const SPIDevice dacDevice = {
+    SPI_DEVICE_DAC, dacSPISettings, PIN_DAC_CS, SPI_PRIORITY_DAC, DAC_CS_DELAY_MICROS, DAC_CS_DELAY_MICROS, DAC_CS_DELAY_MICROS};
+
+void dacs_write(Instrument* inst, bool all) {
+    ProfileScope profile(PROF_DACS_WRITE);
+
+    uint32_t sequence = inst->frames.getSequence();
+    const VoiceFrame& frame = inst->frames.acquire();
 
-void dacs_write(Instrument* inst) {
     for (int i = 0; i < ACTIVE_VOICES; i += 2) {
         Voice* voice_a = &inst->voices[i];
         Voice* voice_b = &inst->voices[i + 1];
+        const VoiceOutputs* out_a = &frame.voices[i];
+        const VoiceOutputs* out_b = &frame.voices[i + 1];
 
         uint8_t* lower_dac = &dac_buffer[DAC_CHANNEL_COUNT * i];
         uint8_t* upper_dac = &dac_buffer[DAC_CHANNEL_COUNT * (i + 1)];
 
-        lower_dac[DAC_CH_A] = float_to_char(voice_a->out_pulse);
-        lower_dac[DAC_CH_B] = float_to_char(voice_b->out_pulse);
-        lower_dac[DAC_CH_C] = float_to_char(voice_b->out_resonance);
-        lower_dac[DAC_CH_D] = float_to_char(voice_b->out_amp * voice_b->volume_correction);
-        lower_dac[DAC_CH_E] = float_to_char(voice_a->out_resonance);
-        lower_dac[DAC_CH_F] = float_to_char(voice_a->out_amp * voice_a->volume_correction);
-        lower_dac[DAC_CH_G] = float_to_char(voice_b->out_sub);
-        lower_dac[DAC_CH_H] = float_to_char(voice_a->out_sub);
+        lower_dac[DAC_CH_A] = float_to_char(out_a->pulse);
+        lower_dac[DAC_CH_B] = float_to_char(out_b->pulse);
+        lower_dac[DAC_CH_C] = float_to_char(out_b->resonance);
+        lower_dac[DAC_CH_D] = float_to_char(out_b->amp);
+        lower_dac[DAC_CH_E] = float_to_char(out_a->resonance);
+        lower_dac[DAC_CH_F] = float_to_char(out_a->amp);
+        lower_dac[DAC_CH_G] = float_to_char(out_b->sub);
+        lower_dac[DAC_CH_H] = float_to_char(out_a->sub);
 
-        uint16_t pitch_a = semis_to_short(apply_correction(voice_a->out_pitch, &voice_a->pitch_correction));
-        uint16_t pitch_b = semis_to_short(apply_correction(voice_b->out_pitch, &voice_b->pitch_correction));
-        uint16_t cutoff_a = semis_to_short(apply_correction(voice_a->out_cutoff, &voice_a->cutoff_correction));
-        uint16_t cutoff_b = semis_to_short(apply_correction(voice_b->out_cutoff, &voice_b->cutoff_correction));
+        uint16_t pitch_a = lookup_code(voice_a->pitch_codes, out_a->pitch);
+        uint16_t pitch_b = lookup_code(voice_b->pitch_codes, out_b->pitch);
+        uint16_t cutoff_a = lookup_code(voice_a->cutoff_codes, out_a->cutoff);
+        uint16_t cutoff_b = lookup_code(voice_b->cutoff_codes, out_b->cutoff);
 
         // debugprintf("pulsea %u, pulseb %u, resb %u, vcab %u, resa %u, vcaa %u, subb %u, suba %u\n",
         //     lower_dac[DAC_CH_A], lower_dac[DAC_CH_B], lower_dac[DAC_CH_C], lower_dac[DAC_CH_D],
@@ -83,27 +138,98 @@ void dacs_write(Instrument* inst) {
         upper_dac[DAC_CH_H] = pitch_a & 0xff;
     }
 
-    enterCritical();
-    spiWrapper.beginTransaction(dacSPISettings);
+    // a channel is written to all dacs of the chain at once, so it
+    // can only be skipped if it is unchanged on every dac
+    bool full_frame = all || force_full_frame || frames_since_full >= DAC_FULL_REFRESH_FRAMES;
+    uint8_t dirty_channels = 0;
+    for (int channel = 0; channel < DAC_CHANNEL_COUNT; channel++) {
+        for (int dac = 0; dac < DAC_COUNT; dac++) {
+            int index = DAC_CHANNEL_COUNT * dac + channel;
+            if (full_frame || dac_buffer[index] != sent_dac_buffer[index]) {
+                dirty_channels |= 1 << channel;
+                break;
+            }
+        }
+    }
 
+    stats.frames++;
+    stats.lastFrameBytes = 0;
+    if (full_frame) {
+        force_full_frame = false;
+        frames_since_full = 0;
+    } else {
+        frames_since_full++;
+    }
+
+    int skipped_channels = DAC_CHANNEL_COUNT - __builtin_popcount(dirty_channels);
+    stats.channelsSkipped += skipped_channels;
+    stats.busMicrosSaved += skipped_channels * stats.channelMicros;
+
+    if (!dirty_channels) {
+        sent_sequence = sequence;
+        return;
+    }
+
+    bool complete = true;
     for (int channel = 0; channel < DAC_CHANNEL_COUNT; channel++) {
-        digitalWrite(PIN_DAC_CS, LOW);
-        delayMicroseconds(DAC_CS_DELAY_MICROS);
+        if (!(dirty_channels & (1 << channel))) {
+            continue;
+        }
 
+        // the last dac of the chain is shifted in first
+        uint16_t words[DAC_COUNT];
         for (int dac = DAC_COUNT - 1; dac >= 0; dac--) {
             uint8_t dac_level = dac_buffer[DAC_CHANNEL_COUNT * dac + channel];
             uint8_t ctrl_msg = channel + 1;
-            // send msg
-            uint16_t serial_msg = (ctrl_msg << 12) | (dac_level << 4);
-            spiWrapper.transfer16(serial_msg);
-
-            delayMicroseconds(DAC_CS_DELAY_MICROS);
+            words[DAC_COUNT - 1 - dac] = (ctrl_msg << 12) | (dac_level << 4);
+        }
+        bool queued = spiBus.submit(dacDevice, words, DAC_COUNT);
+        while (!queued && all) {
+            spiBus.service();  // a flush waits for room instead of leaving the channel for later
+            queued = spiBus.submit(dacDevice, words, DAC_COUNT);
+        }
+        if (!queued) {
+            force_full_frame = true;  // resend once there is room
+            complete = false;
+            continue;
         }
+        for (int dac = 0; dac < DAC_COUNT; dac++) {
+            sent_dac_buffer[DAC_CHANNEL_COUNT * dac + channel] = dac_buffer[DAC_CHANNEL_COUNT * dac + channel];
+        }
+
+        stats.channelsSent++;
+        stats.lastFrameBytes += DAC_CHANNEL_BYTES;
+    }
 
-        digitalWrite(PIN_DAC_CS, HIGH);
-        delayMicroseconds(DAC_CS_DELAY_MICROS);
+    spiBus.service();
+    if (complete) {
+        sent_sequence = sequence;
     }
 
-    spiWrapper.endTransaction();
-    exitCritical();
+    const SPIBusStats& bus = spiBus.getStats(SPI_PRIORITY_DAC);
+    if (bus.transactions) {
+        stats.channelMicros = bus.busyMicros / bus.transactions;
+    }
+    stats.bytesSent += stats.lastFrameBytes;
+}
+
+uint32_t dacs_sent_sequence() {
+    return sent_sequence;
+}
+
+void dacs_force_full_frame() {
+    force_full_frame = true;
+}
+
+const DacStats& dacs_get_stats() {
+    return stats;
+}
+
+void dacs_print_stats() {
+    printf("\ndacs: %lu frames, %lu channels sent, %lu skipped, %lu bytes in last frame\n",
+           (unsigned long)stats.frames, (unsigned long)stats.channelsSent, (unsigned long)stats.channelsSkipped,
+           (unsigned long)stats.lastFrameBytes);
+    printf("dacs: %llu bytes sent, %llu us bus time saved, %lu us per channel\n",
+           (unsigned long long)stats.bytesSent, (unsigned long long)stats.busMicrosSaved,
+           (unsigned long)stats.channelMicros);
 }
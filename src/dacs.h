@@ -1,4 +1,24 @@
 #pragma once
 #include "instrument.h"
 
-void dacs_write(Instrument* instrument);
\ No newline at end of file
+struct DacStats {
+    uint32_t frames = 0;
+    uint32_t channelsSent = 0;
+    uint32_t channelsSkipped = 0;
+    uint32_t lastFrameBytes = 0;
+    uint64_t bytesSent = 0;
+    uint64_t busMicrosSaved = 0;
+    // measured bus time of one channel
+    uint32_t channelMicros = 0;
+};
+
+// sends the dirty channels of the latest frame in one run, all sends every
+// channel and only returns once they are on the dacs
+void dacs_write(Instrument* instrument, bool all);
+void dacs_compile_correction(const TuningCorrection& corr, DacCodeTable& table);
+// sequence of the newest published frame which is completely on the dacs
+uint32_t dacs_sent_sequence();
+// next write sends all channels even if unchanged
+void dacs_force_full_frame();
+const DacStats& dacs_get_stats();
+void dacs_print_stats();
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Double buffer handing frames from a producer to a consumer running at
+ * its own rate. The producer fills back() and calls publish(), the consumer
+ * reads acquire(). The consumer may preempt the producer (e.g. a timer task)
+ * but not the other way around, so it always finishes reading a frame before
+ * the producer can start overwriting it.
+ */
+template <typename T>
+class DoubleBuffer {
+    T buffers[2] = {};
+    volatile uint8_t front = 0;
+    volatile uint32_t sequence = 0;
+
+   public:
+    T& back() {
+        return buffers[front ^ 1];
+    }
+
+    void publish() {
+        // frame contents must be written before it becomes visible
+        std::atomic_signal_fence(std::memory_order_release);
+        front = front ^ 1;
+        sequence = sequence + 1;
+    }
+
+    const T& acquire() const {
+        const T& frame = buffers[front];
+        std::atomic_signal_fence(std::memory_order_acquire);
+        return frame;
+    }
+
+    // incremented on every publish, lets the consumer detect fresh frames
+    uint32_t getSequence() const {
+        return sequence;
+    }
+};
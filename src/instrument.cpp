@@ -2,19 +2,19 @@
 
 #include <Arduino.h>
 
-#include "SPIWrapper.h"
+#include "SPIBus.h"
 #include "config.h"
 #include "core_pins.h"
 #include "dacs.h"
 #include "panel.h"
+#include "profiler.h"
 #include "sine.h"
 #include "utils.h"
 
-static float clamp01(float x) {
-    if (x < 0.0) x = 0.0;
-    if (x > 1.0) x = 1.0;
-    return x;
-}
+// MCP4802 for the chorus, one word per channel
+static const SPIDevice chorusDacDevice = {SPI_DEVICE_CHORUS_DAC, mcp4802Settings, PIN_CHORUS_DAC_CS, SPI_PRIORITY_AUDIO, 1, 0, 1};
+// PGA2311 main volume, both channels in one word
+static const SPIDevice mainAmpDevice = {SPI_DEVICE_AMP, pga2311Settings, PIN_AMP_CS, SPI_PRIORITY_AUDIO, 3, 0, 3};
 
 static float clamp(float x, float lo, float hi) {
     if (x < lo) x = lo;
@@ -22,107 +22,6 @@ static float clamp(float x, float lo, float hi) {
     return x;
 }
 
-#define ADSR_EPS 0.05
-#define ADSR_MINUS_LN_EPS 2.9957
-
-void Envelope::update(float dt, bool gate) {
-    if (this->lastGate != gate) {
-        this->lastGate = gate;
-        this->state = gate ? ENVELOPE_ATTACK : ENVELOPE_RELEASE;
-    }
-
-    float target = 0, period = 1;
-
-    switch (this->state) {
-        case ENVELOPE_ATTACK:
-            target = 1.0;
-            period = this->attack;
-            break;
-        case ENVELOPE_DECAY:
-            target = this->sustain;
-            period = this->decay;
-            break;
-        case ENVELOPE_RELEASE:
-            target = 0;
-            period = this->release;
-            break;
-    }
-
-    float lambda = ADSR_MINUS_LN_EPS / period;
-    float delta = target - this->level;
-
-    this->level += delta * clamp01(lambda * dt);
-
-    float err = fabsf(delta);
-
-    if (this->state == ENVELOPE_ATTACK && err < ADSR_EPS) {
-        this->state = ENVELOPE_DECAY;
-    }
-}
-
-void Lfo::update(float dt, bool gate) {
-    if (!previousGate && gate) {
-        time = 0;
-    }
-    previousGate = gate;
-    if (time < delayTime) {
-        amplitude = 0;
-    } else {
-        // really basic linear amplitude
-        amplitude = min(1, (time - delayTime) * 50);
-    }
-
-    x += 2 * M_PI * (frequency + drift) * dt;
-
-    level = amplitude * sineApprox(x);
-    time += dt;
-}
-
-void Voice::update(float dt, Patch* patch, int16_t* settings, float syncedLfoVoltage, float pitchBend, float modWheel) {
-    env.attack = 10 * faderLog(patch->faders[FD_ATTACK]);
-    env.decay = 10 * faderLog(patch->faders[FD_DECAY]);
-    env.sustain = faderLin(patch->faders[FD_SUSTAIN]);
-    env.release = 10 * faderLog(patch->faders[FD_RELEASE]);
-
-    lfo.frequency = 20 * faderLog(patch->faders[FD_LFO_RATE]);
-    lfo.delayTime = 5 * faderLog(patch->faders[FD_LFO_DELAY]);
-    lfo.update(dt, gate);
-
-    float lfoVoltage = patch->switches[SW_LFO_SYNC] ? syncedLfoVoltage : lfo.level;
-
-    env.update(dt, gate);
-
-    float vcoLfo = 30 * faderLog(patch->faders[FD_VIBRATO]);
-    float vcfFreq = lerp(faderLin(patch->faders[FD_CUTOFF]), -20, 60);
-    float vcfKybd = faderLinSnap(patch->faders[FD_FILTER_KEYTRACK], 0.05);
-    float vcfLfo = 30 * faderLog(patch->faders[FD_FILTER_LFO]);
-    float vcfEnv = 80 * faderLin(patch->faders[FD_FILTER_ENVELOPE]);
-
-    float modVibratoFactor = 25 * faderLog(settings[INS_MOD_VCO]);
-    float modTremoloFactor = 60 * faderLog(settings[INS_MOD_VCF]);
-    float vibrato = vcoLfo + modVibratoFactor * modWheel;
-    float tremolo = vcfLfo + modTremoloFactor * modWheel;
-
-    float pitchBendRange = settings[INS_BEND_OCTAVE] ? 12.0f : 2.0f;
-    float pitchBendPitch = pitchBend * pitchBendRange;
-
-    float pwm = faderLin(patch->faders[FD_PULSE_WIDTH]);
-    out_pitch = note + vibrato * lfoVoltage + pitchBendPitch;
-    out_cutoff = vcfFreq + vcfKybd * note + tremolo * lfoVoltage + vcfEnv * env.level;
-    out_pulse = chooseValue(
-        0.5 + 0.5 * env.level * pwm,
-        0.5 + 0.5 * lfoVoltage * pwm,
-        pwm,
-        patch->switches[SW_VCO_PWM_SOURCE]);
-    out_sub = faderLin(patch->faders[FD_SUB_OSCILLATOR]);
-    out_resonance = 0.6 * faderLin(patch->faders[FD_RESONANCE]);
-    out_amp = 0.4 * chooseValue(
-                        env.level,
-                        gate ? 1.0 : 0,
-                        0.0,
-                        patch->switches[SW_AMP_SHAPE]);
-}
-
 Instrument::Instrument(PanelLedController& leds) : leds(leds) {
     memset(settings, 0, sizeof(settings));
 
@@ -142,48 +41,72 @@ Instrument::Instrument(PanelLedController& leds) : leds(leds) {
         0.4507f};
 
     for (int i = 0; i < ACTIVE_VOICES; i++) {
-        // voices[i].lfo.time = 11.392183 * random_phase_offsets[i];
-        voices[i].lfo.drift = 0.05 * random_phase_offsets[i];
+        // lfos.time[i] = 11.392183 * random_phase_offsets[i];
+        lfos.drift[i] = 0.05 * random_phase_offsets[i];
     }
-}
-
-void Instrument::update(float dt) {
-    // must match implementation in voice
-    syncedLfo.frequency = 20 * faderLog(patch.faders[FD_LFO_RATE]);
-    syncedLfo.delayTime = 5 * faderLog(patch.faders[FD_LFO_DELAY]);
 
-    bool anyGate = false;
-    for (int i = 0; i < ACTIVE_VOICES; i++) {
-        anyGate = anyGate || voices[i].gate;
+    for (int i = 0; i < VOICE_COUNT; i++) {
+        voices[i].compileCorrections();
     }
-    syncedLfo.update(dt, anyGate);
+}
 
-    int numVirtualVoices = ACTIVE_VOICES / unisonDivisor;
-    for (int i = numVirtualVoices; i < ACTIVE_VOICES; i++) {
-        voices[i].note = voices[i % numVirtualVoices].note;
-        voices[i].gate = voices[i % numVirtualVoices].gate;
+void Instrument::updateParams() {
+    bool settingsChanged =
+        settings[INS_MOD_VCO] != paramsSettings[INS_MOD_VCO] ||
+        settings[INS_MOD_VCF] != paramsSettings[INS_MOD_VCF] ||
+        settings[INS_BEND_OCTAVE] != paramsSettings[INS_BEND_OCTAVE];
+    // compare members, padding of Patch is not copied reliably
+    bool patchChanged =
+        memcmp(patch.faders, paramsPatch.faders, sizeof(patch.faders)) != 0 ||
+        memcmp(patch.switches, paramsPatch.switches, sizeof(patch.switches)) != 0;
+    if (paramsGeneration > 0 && !settingsChanged && !patchChanged) {
+        return;
     }
+    paramsPatch = patch;
+    memcpy(paramsSettings, settings, sizeof(settings));
+    paramsGeneration++;
 
-    // instrSettings[INS_MOD_VCO], instrSettings[INS_MOD_VCF], instrSettings[INS_PITCHBEND], instrSettings[INS_MODWHEEL]
-    float pitchBend = ((float)settings[INS_PITCHBEND] - pitchBendCenter) / 150.0f;
-    // printf("settings[INS_PITCHBEND]=%f, pitchBendCenter=%f, pitchBend=%f\n", (float)settings[INS_PITCHBEND], pitchBendCenter, pitchBend);
+    params.attack = 10 * faderLog(patch.faders[FD_ATTACK]);
+    params.decay = 10 * faderLog(patch.faders[FD_DECAY]);
+    params.sustain = faderLin(patch.faders[FD_SUSTAIN]);
+    params.release = 10 * faderLog(patch.faders[FD_RELEASE]);
 
-    const float pitchBendThreshold = 0.1;
-    pitchBend -= clamp(pitchBend, -pitchBendThreshold, pitchBendThreshold);
-    pitchBend *= 1.0 / (1.0 - pitchBendThreshold);
-    pitchBend = clamp(pitchBend, -1.0, 1.0);
+    params.lfoFrequency = 20 * faderLog(patch.faders[FD_LFO_RATE]);
+    params.lfoDelay = 5 * faderLog(patch.faders[FD_LFO_DELAY]);
 
-    float modWheel = ((float)modCenter - settings[INS_MODWHEEL]) / 153.0f;
-    // printf("modWheel=%f\n", modWheel);
+    params.vibrato = 30 * faderLog(patch.faders[FD_VIBRATO]);
+    params.modVibrato = 25 * faderLog(settings[INS_MOD_VCO]);
 
-    const float modWheelThreshold = 0.05;
-    modWheel -= clamp(modWheel, 0, modWheelThreshold);
-    modWheel *= 1.0 / (1.0 - modWheelThreshold);
-    modWheel = clamp(modWheel, 0.0, 1.0);
+    params.cutoff = lerp(faderLin(patch.faders[FD_CUTOFF]), -20, 60);
+    params.cutoffKeytrack = faderLinSnap(patch.faders[FD_FILTER_KEYTRACK], 0.05);
+    params.cutoffLfo = 30 * faderLog(patch.faders[FD_FILTER_LFO]);
+    params.cutoffEnvelope = 80 * faderLin(patch.faders[FD_FILTER_ENVELOPE]);
+    params.modTremolo = 60 * faderLog(settings[INS_MOD_VCF]);
 
-    for (int i = 0; i < ACTIVE_VOICES; i++) {
-        // debugprintf("%u, %u, %u\n", i, voices[i].note, voices[i].gate);
-        voices[i].update(dt, &patch, settings, syncedLfo.level, pitchBend, modWheel);
+    params.pitchBendRange = settings[INS_BEND_OCTAVE] ? 12.0f : 2.0f;
+
+    params.pulseWidth = faderLin(patch.faders[FD_PULSE_WIDTH]);
+    params.sub = faderLin(patch.faders[FD_SUB_OSCILLATOR]);
+    params.resonance = 0.6 * faderLin(patch.faders[FD_RESONANCE]);
+
+    params.lfoSync = patch.switches[SW_LFO_SYNC];
+    params.pwmSource = patch.switches[SW_VCO_PWM_SOURCE];
+    params.ampShape = patch.switches[SW_AMP_SHAPE];
+}
+
+void Instrument::update(float dt) {
+    ProfileScope profile(PROF_INSTR_UPDATE);
+
+    updateParams();
+
+    int numVirtualVoices = ACTIVE_VOICES / unisonDivisor;
+    for (int i = numVirtualVoices; i < ACTIVE_VOICES; i++) {
+        if (isVoiceReserved(i)) {
+            voices[i].gate = false;  // unison copy is dropped while tuning
+            continue;
+        }
+        voices[i].note = voices[i % numVirtualVoices].note;
+        voices[i].gate = voices[i % numVirtualVoices].gate;
     }
 
     int square = patch.switches[SW_VCO_SQUARE] & 1;
@@ -208,30 +131,82 @@ void Instrument::update(float dt) {
         case 0b01:
             chorusMix = 0.8;
             chorusVolumeFactor = 0.8;
-            chorusLfoLeft.frequency = 0.2;
-            chorusLfoRight.frequency = 0.2;
+            lfos.frequency[LFO_CHORUS_LEFT] = 0.2;
+            lfos.frequency[LFO_CHORUS_RIGHT] = 0.2;
             break;
         case 0b10:
             chorusMix = 0.6;
             chorusVolumeFactor = 0.8;
-            chorusLfoLeft.frequency = 0.4;
-            chorusLfoRight.frequency = 0.4;
+            lfos.frequency[LFO_CHORUS_LEFT] = 0.4;
+            lfos.frequency[LFO_CHORUS_RIGHT] = 0.4;
             break;
         case 0b11:
             chorusMix = 0.1;
             chorusVolumeFactor = 0.8;
-            chorusLfoLeft.frequency = 2.7;
-            chorusLfoRight.frequency = 2.7;
+            lfos.frequency[LFO_CHORUS_LEFT] = 2.7;
+            lfos.frequency[LFO_CHORUS_RIGHT] = 2.7;
             break;
     }
-    chorusLfoRight.x = chorusLfoLeft.x + 0.5 * M_PI;
 
-    chorusLfoLeft.update(dt, false);
-    chorusLfoRight.update(dt, false);
+    // all lfos in one pass, right chorus lfo stays in quadrature with left
+    lfos.phase[LFO_CHORUS_RIGHT] = lfos.phase[LFO_CHORUS_LEFT] + PHASE_QUARTER;
+
+    bool anyGate = false;
+    for (int i = 0; i < VOICE_COUNT; i++) {
+        bank.note[i] = voices[i].note;
+        bank.gate[i] = voices[i].gate;
+        lfos.gate[i] = voices[i].gate;
+        anyGate = anyGate || voices[i].gate;
+    }
+    for (int i = 0; i <= LFO_SYNCED; i++) {
+        lfos.frequency[i] = params.lfoFrequency;
+        lfos.delay[i] = params.lfoDelay;
+    }
+    lfos.gate[LFO_SYNCED] = anyGate;
+
+    lfos.update(dt);
+
+    // instrSettings[INS_MOD_VCO], instrSettings[INS_MOD_VCF], instrSettings[INS_PITCHBEND], instrSettings[INS_MODWHEEL]
+    float pitchBend = ((float)settings[INS_PITCHBEND] - pitchBendCenter) / 150.0f;
+    // printf("settings[INS_PITCHBEND]=%f, pitchBendCenter=%f, pitchBend=%f\n", (float)settings[INS_PITCHBEND], pitchBendCenter, pitchBend);
+
+    const float pitchBendThreshold = 0.1;
+    pitchBend -= clamp(pitchBend, -pitchBendThreshold, pitchBendThreshold);
+    pitchBend *= 1.0 / (1.0 - pitchBendThreshold);
+    pitchBend = clamp(pitchBend, -1.0, 1.0);
+
+    float modWheel = ((float)modCenter - settings[INS_MODWHEEL]) / 153.0f;
+    // printf("modWheel=%f\n", modWheel);
+
+    const float modWheelThreshold = 0.05;
+    modWheel -= clamp(modWheel, 0, modWheelThreshold);
+    modWheel *= 1.0 / (1.0 - modWheelThreshold);
+    modWheel = clamp(modWheel, 0.0, 1.0);
+
+    // envelopes and outputs of all voices
+    bank.update(dt, params, lfos.level, lfos.level[LFO_SYNCED], pitchBend, modWheel);
 
     mainVolume = chorusVolumeFactor * (settings[INS_VOLUME] / 1024.0f);
     // debugprintf("%.2f\n", mainVolume);
     // delay(100);
+
+    applyTuningOutputs();
+
+    publishFrame();
+}
+
+void Instrument::publishFrame() {
+    VoiceFrame& frame = frames.back();
+    for (int i = 0; i < VOICE_COUNT; i++) {
+        VoiceOutputs& out = frame.voices[i];
+        out.pitch = bank.outPitch[i];
+        out.cutoff = bank.outCutoff[i];
+        out.pulse = bank.outPulse[i];
+        out.sub = bank.outSub[i];
+        out.resonance = bank.outResonance[i];
+        out.amp = bank.outAmp[i] * voices[i].volume_correction;
+    }
+    frames.publish();
 }
 
 void Instrument::scheduleNoteOn(int note, int velocity) {
@@ -242,15 +217,17 @@ void Instrument::scheduleNoteOn(int note, int velocity) {
         return;
     }
 
+    abortDriftMeasurement();  // playing always wins
+
     for (int i = 0; i < numVirtualVoices; i++) {
         if (voices[i].gate && voices[i].note == note) {
             return;  // some voice is already playing that note :(
         }
     }
 
-    int oldest = 0;
-    int oldestTag = voices[0].schedulingTag;
-    bool oldestGate = voices[0].gate;
+    int oldest = -1;
+    int oldestTag = 0;
+    bool oldestGate = false;
 
     // if (monoVoice >= 0) {
     //     // schedule mono voice
@@ -259,24 +236,31 @@ void Instrument::scheduleNoteOn(int note, int velocity) {
 
     // find oldest voice or steal active one
     for (int i = 0; i < numVirtualVoices; i++) {
+        if (isVoiceReserved(i)) {
+            continue;  // being calibrated
+        }
         int currentTag = voices[i].schedulingTag;
         int currentGate = voices[i].gate;
         // higher priority for scheduling voice if gate off but respect tag on both ends
         // => lexicographic ordering of (gate, tag)
-        if ((!currentGate && oldestGate) || (currentGate == oldestGate && currentTag < oldestTag)) {
+        if (oldest < 0 || (!currentGate && oldestGate) || (currentGate == oldestGate && currentTag < oldestTag)) {
             oldest = i;
             oldestTag = currentTag;
             oldestGate = currentGate;
         }
     }
 
+    if (oldest < 0) {
+        return;  // only voice is being calibrated
+    }
+
     // schedule oldest voice and steal if necessary
     Voice& next = voices[oldest];
 
     if (next.gate) {
         // steal voice, shut down envelope such that it starts correctly
-        next.env.level = 0;
-        next.env.state = EnvelopeState::ENVELOPE_ATTACK;
+        bank.envLevel[oldest] = 0;
+        bank.envState[oldest] = ENVELOPE_ATTACK;
     }
 
     next.note = note;
@@ -314,29 +298,37 @@ void reset_correction(TuningCorrection& corr) {
     corr.parabolic[0] = 0;
     corr.parabolic[1] = 1;
     corr.parabolic[2] = 0;
+    spline_reset(corr.spline);
+    corr.offset = 0;
+}
+
+void Voice::compileCorrections() {
+    dacs_compile_correction(pitch_correction, pitch_codes);
+    dacs_compile_correction(cutoff_correction, cutoff_codes);
 }
 
 void Instrument::test() {
-    int i = 1;
+    int voiceIndex = 1;
 
-    for (Voice& v : voices) {
-        v.out_amp = 0;
+    for (int i = 0; i < VOICE_COUNT; i++) {
+        bank.outAmp[i] = 0;
     }
 
     mixer = MIXER_SAW /*  | MIXER_SQR */;
     chorusType = 0;
     mainVolume = 0.8;
 
-    Voice& v = getVoice(i);
-    v.out_pitch = 50;
-    v.out_cutoff = 50;
-    v.out_pulse = 0.5;
-    v.out_resonance = 0;
-    v.out_sub = 0.6;
-    v.out_amp = 0.8;
+    Voice& v = getVoice(voiceIndex);
+    bank.outPitch[voiceIndex] = 50;
+    bank.outCutoff[voiceIndex] = 50;
+    bank.outPulse[voiceIndex] = 0.5;
+    bank.outResonance[voiceIndex] = 0;
+    bank.outSub[voiceIndex] = 0.6;
+    bank.outAmp[voiceIndex] = 0.8;
 
     reset_correction(v.pitch_correction);
     reset_correction(v.cutoff_correction);
+    v.compileCorrections();
 
     while (true) {
         // write();
@@ -368,8 +360,8 @@ void Instrument::test() {
         // delay(1000);
 
         for (int i = 10; i < 100; i += 10) {
-            v.out_pitch = (float)i;
-            debugprintf("%.2f\n", v.out_pitch);
+            bank.outPitch[voiceIndex] = (float)i;
+            debugprintf("%.2f\n", bank.outPitch[voiceIndex]);
             write();
             delay(500);
         }
@@ -381,31 +373,24 @@ void Instrument::test() {
 }
 
 void Instrument::testChorus() {
-    Lfo lfo;
-    lfo.frequency = 0.1;
+    LfoBank<1> lfo;
+    lfo.frequency[0] = 0.1;
 
     while (1) {
-        debugprintf("%f\n", lfo.level);
+        debugprintf("%f\n", lfo.level[0]);
 
-        lfo.update(0.1, false);
+        lfo.update(0.1);
         delay(100);
 
-        float normalized = 0.25 + 0.75 * (0.5 + 0.5 * lfo.level);
+        float normalized = 0.25 + 0.75 * (0.5 + 0.5 * lfo.level[0]);
         int level = (int)(255 * normalized);
 
-        enterCritical();
-        spiWrapper.beginTransaction(mcp4802Settings);
-        digitalWrite(PIN_CHORUS_DAC_CS, LOW);
-        delayMicroseconds(1);
-        spiWrapper.transfer16((1 << 12) | (level << 4));  // 12bit means dac active
-        digitalWrite(PIN_CHORUS_DAC_CS, HIGH);
-        delayMicroseconds(1);
-        digitalWrite(PIN_CHORUS_DAC_CS, LOW);
-        delayMicroseconds(1);
-        spiWrapper.transfer16((1 << 15) | (1 << 12) | (level << 4));  // 15 bit means channel B
-        digitalWrite(PIN_CHORUS_DAC_CS, HIGH);
-        spiWrapper.endTransaction();
-        exitCritical();
+        uint16_t channelA = (1 << 12) | (level << 4);              // 12bit means dac active
+        uint16_t channelB = (1 << 15) | (1 << 12) | (level << 4);  // 15 bit means channel B
+        SPITicket ticket;
+        spiBus.submit(chorusDacDevice, &channelA, 1);
+        spiBus.submit(chorusDacDevice, &channelB, 1, &ticket);
+        spiBus.wait(ticket);
     }
 }
 
@@ -440,9 +425,19 @@ char chorus_level(float lfo) {
     return toClampedChar(255 * normalized);
 }
 
+// writes current voice values synchronously, used outside of the control loop
 void Instrument::write() {
-    dacs_write(this);
+    publishFrame();
+    dacs_write(this, true);
+    writeAudioPath();
+}
 
+// sends the most recently published frame
+void Instrument::writeDacs() {
+    dacs_write(this, false);
+}
+
+void Instrument::writeAudioPath() {
     // debugprintf("Mixer: %d\n", mixer);
 
     digitalWrite(PIN_EN_SAW, !(mixer & MIXER_SAW));
@@ -450,44 +445,25 @@ void Instrument::write() {
     digitalWrite(PIN_CHORUS_1, !chorusType);
     digitalWrite(PIN_CHORUS_2, !chorusType);
 
+    ProfileScope profile(PROF_INSTR_SPI_WRITE);
+
     // MCP4802 for chorus
     // int levelA = toClampedChar(255 * chorusLfoLeft.level);
     // int levelB = toClampedChar(255 * chorusLfoRight.level);
-    int levelA = chorus_level(chorusMix * chorusLfoLeft.level);
-    int levelB = chorus_level(chorusMix * chorusLfoRight.level);
+    int levelA = chorus_level(chorusMix * lfos.level[LFO_CHORUS_LEFT]);
+    int levelB = chorus_level(chorusMix * lfos.level[LFO_CHORUS_RIGHT]);
 
-    enterCritical();
-    spiWrapper.beginTransaction(mcp4802Settings);
-    digitalWrite(PIN_CHORUS_DAC_CS, LOW);
-    delayMicroseconds(1);
-
-    spiWrapper.transfer16((1 << 12) | (levelA << 4));  // 12bit means dac active
-
-    digitalWrite(PIN_CHORUS_DAC_CS, HIGH);
-    delayMicroseconds(1);
-
-    digitalWrite(PIN_CHORUS_DAC_CS, LOW);
-    delayMicroseconds(1);
-
-    spiWrapper.transfer16((1 << 15) | (1 << 12) | (levelB << 4));  // 15 bit means channel B
-
-    digitalWrite(PIN_CHORUS_DAC_CS, HIGH);
-    spiWrapper.endTransaction();
-    exitCritical();
+    uint16_t channelA = (1 << 12) | (levelA << 4);              // 12bit means dac active
+    uint16_t channelB = (1 << 15) | (1 << 12) | (levelB << 4);  // 15 bit means channel B
+    spiBus.submit(chorusDacDevice, &channelA, 1);
+    spiBus.submit(chorusDacDevice, &channelB, 1);
 
     // PGA2311
-    enterCritical();
-    spiWrapper.beginTransaction(pga2311Settings);
-    digitalWrite(PIN_AMP_CS, LOW);
-    delayMicroseconds(3);
-
     char mainGain = toClampedChar(255 * mainVolume);
-    spiWrapper.transfer16((mainGain << 8) | mainGain);
+    uint16_t gains = (mainGain << 8) | mainGain;
+    spiBus.submit(mainAmpDevice, &gains, 1);
 
-    digitalWrite(PIN_AMP_CS, HIGH);
-    delayMicroseconds(3);
-    spiWrapper.endTransaction();
-    exitCritical();
+    spiBus.service();
 }
 
 Patch& Instrument::getPatch() {
@@ -1,19 +1,16 @@
 #pragma once
 #include "config.h"
+#include "frames.h"
 #include "led.h"
 #include "patch.h"
+#include "spline.h"
+#include "voicebank.h"
 
 #define VOICE_COUNT 8
 
 #define MIXER_SAW 1
 #define MIXER_SQR 2
 
-enum EnvelopeState {
-    ENVELOPE_ATTACK,
-    ENVELOPE_DECAY,
-    ENVELOPE_RELEASE,
-};
-
 enum InstrumentSettings {
     INS_PITCHBEND,
     INS_MODWHEEL,
@@ -26,28 +23,42 @@ enum InstrumentSettings {
     INS__COUNT__,
 };
 
-class Envelope {
-   public:
-    float attack = 0, decay = 0, sustain = 1, release = 0, level = 0;
-    EnvelopeState state = ENVELOPE_RELEASE;
-    bool lastGate = false;
-    void update(float dt, bool gate);
-};
-
-class Lfo {
-   public:
-    bool previousGate = false;
-    float delayTime = 0, time = 0, x = 0, level = 0, frequency = 1, drift = 0, amplitude = 1;
-    void update(float dt, bool gate);
-};
+// slots of the lfo bank, one per voice followed by the instrument wide lfos
+#define LFO_SYNCED VOICE_COUNT
+#define LFO_CHORUS_LEFT (VOICE_COUNT + 1)
+#define LFO_CHORUS_RIGHT (VOICE_COUNT + 2)
+#define LFO_COUNT (VOICE_COUNT + 3)
 
 struct TuningCorrection {
     // float slope = 1, intersept = 0;
     float parabolic[3] = {0, 1, 0};
+    // used instead of the parabola once fitted
+    TuningSpline spline;
+    // drift compensation in semis, added after the fit and never saved
+    float offset = 0;
 };
 
 void reset_correction(TuningCorrection& corr);
 
+// corrected dac codes over the cv range, linearly interpolated in between
+#define DAC_TABLE_MIN_SEMIS -8
+#define DAC_TABLE_MAX_SEMIS 136
+#define DAC_TABLE_STEPS_PER_SEMI 16
+#define DAC_TABLE_SIZE ((DAC_TABLE_MAX_SEMIS - DAC_TABLE_MIN_SEMIS) * DAC_TABLE_STEPS_PER_SEMI + 1)
+
+struct DacCodeTable {
+    uint16_t codes[DAC_TABLE_SIZE];
+};
+
+// warm-up drift of a voice, extrapolated between background measurements
+struct DriftModel {
+    bool measured = false;
+    float offset = 0;  // semis at the last measurement
+    float rate = 0;    // semis per second at the last measurement
+    uint32_t measuredMillis = 0;
+};
+
+// scheduling and calibration state, per frame state is kept in the voice bank
 struct Voice {
     // scheduling
     // no two voices should be gated and contain the same note
@@ -55,25 +66,58 @@ struct Voice {
     bool gate = false;
     int schedulingTag = -1;  // higher signifies recent change
 
-    Envelope env;
-    Lfo lfo;
-
-    // final values, uncorrected
-    float out_pitch, out_cutoff, out_pulse,
-        out_sub, out_resonance, out_amp;
-
     TuningCorrection pitch_correction, cutoff_correction;
     float volume_correction = 1;
 
-    void update(float dt, Patch* patch, int16_t* settings, float syncedLfoLevel, float pitchBend, float modWheel);
+    // compiled from the corrections, must be recompiled after changing them
+    DacCodeTable pitch_codes, cutoff_codes;
+    void compileCorrections();
+
+    DriftModel drift;
+};
+
+#define TUNING_SAMPLES 24
+
+enum TuningStep {
+    TUNING_IDLE,
+    TUNING_WAIT_RELEASE,  // voice still holds a note
+    TUNING_WAIT_SILENCE,  // loopback carries the sum of all voices
+    TUNING_SETTLE,
+    TUNING_MEASURE,
+};
+
+// progress of the background calibration, one voice and profile at a time
+struct TuningJob {
+    TuningStep step = TUNING_IDLE;
+    bool isDrift = false;  // short pitch check of an idle voice, see trackDrift()
+    int voice = 0;
+    bool isFilter = false;
+    int sample = 0;
+    int successfulSamples = 0;
+    float x[TUNING_SAMPLES], y[TUNING_SAMPLES];
+    uint32_t stepStartMillis = 0;
+    uint32_t settleFrame = 0;  // first frame carrying the current sample
+    TuningCorrection previousCorrection;  // restored if the fit fails
+    float driftError = 0;                 // sum over the drift points, semis sharp
+};
+
+// values published to the dacs, volume correction already applied to amp
+struct VoiceOutputs {
+    float pitch, cutoff, pulse, sub, resonance, amp;
+};
+
+struct VoiceFrame {
+    VoiceOutputs voices[VOICE_COUNT];
 };
 
 class Instrument {
     Voice voices[VOICE_COUNT];
+    VoiceBank<VOICE_COUNT> bank;
+    DoubleBuffer<VoiceFrame> frames;
     int mixer = MIXER_SAW;
     int chorusType = 0;
     int schedulingTagCounter = 0;
-    Lfo chorusLfoLeft, chorusLfoRight, syncedLfo;
+    LfoBank<LFO_COUNT> lfos;
     float chorusMix = 1;
     float mainVolume = 1;
     float modCenter, pitchBendCenter;
@@ -85,8 +129,33 @@ class Instrument {
     int16_t settings[INS__COUNT__];
     Patch patch;
 
+    // derived parameters, only recomputed if the patch or settings change
+    PatchParams params;
+    Patch paramsPatch;
+    int16_t paramsSettings[INS__COUNT__];
+    uint32_t paramsGeneration = 0;  // incremented on every recompute
+
+    TuningJob tuningJob;
+    uint32_t silentSinceMillis = 0;
+    uint32_t driftPredictMillis = 0;
+    int driftPredictVoice = 0;
+
+    void updateParams();
+    void publishFrame();
     float measureFrequency(int voiceIndex, float semis, bool isFilter);
-    int findTuningProfile(int voiceIndex, float semis_a, float semis_b, bool isFilter);
+    bool isVoiceReserved(int voiceIndex);
+    bool otherVoicesSilent(int voiceIndex);
+    float tuningSampleSemis();
+    void applyTuningOutputs();
+    void yieldTuningToPlaying();
+    void setTuningStep(TuningStep step);
+    void nextTuningSample();
+    void finishTuningProfile();
+    void finishTuning();
+    void trackDrift();
+    void predictDrift();
+    void nextDriftPoint();
+    void abortDriftMeasurement();
 
    public:
     Instrument(PanelLedController& leds);
@@ -95,10 +164,15 @@ class Instrument {
     int16_t* getSettings();
 
     void load_tuning();
+    // starts calibrating in the background, advanced by updateTuning()
     void tune();
+    void updateTuning();
+    bool isTuningActive();
     void testTuning();
     void update(float dt);
     void write();
+    void writeDacs();
+    void writeAudioPath();
     void scheduleNoteOn(int note, int velocity);
     void scheduleNoteOff(int note);
     void allNotesOff();
@@ -111,5 +185,5 @@ class Instrument {
 
     Instrument(const Instrument&) = delete;
 
-    friend void dacs_write(Instrument* inst);
+    friend void dacs_write(Instrument* inst, bool all);
 };
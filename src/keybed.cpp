@@ -1,6 +1,9 @@
 #include "keybed.h"
 
+#include <cmath>
+
 #include "config.h"
+#include "profiler.h"
 
 /**
  * [Bank]: first or second keyboard matrix
@@ -30,11 +33,43 @@ int16_t keyMatrices[2][8][8] = {
 // per bank input from mux
 int keyMatrixInputs[2] = {PIN_KYBD_MUX_1, PIN_KYBD_MUX_2};
 
-static int calculateVelocity(uint32_t millis) {
-    return std::min(127, 1000 / (int)millis);
+// keyMatrices scattered into contact masks, zero for unused addresses
+static uint64_t firstContactBits[2][8][8];
+static uint64_t secondContactBits[2][8][8];
+
+static void buildContactBits() {
+    for (int bank = 0; bank < 2; bank++) {
+        for (int row = 0; row < 8; row++) {
+            for (int column = 0; column < 8; column++) {
+                int button = keyMatrices[bank][row][column];
+                firstContactBits[bank][row][column] = button >= 0 && button < 100 ? 1ull << button : 0;
+                secondContactBits[bank][row][column] = button >= 100 ? 1ull << (button - 100) : 0;
+            }
+        }
+    }
+}
+
+static MatrixLevel contactLevel(uint64_t first, uint64_t second, int key) {
+    if ((second >> key) & 1) {
+        return MatrixLevel::BOTH;
+    }
+    return ((first >> key) & 1) ? MatrixLevel::FIRST : MatrixLevel::OPEN;
+}
+
+// log curve between the fastest and the slowest strike, equal travel ratios are equal velocity steps
+static int calculateVelocity(uint32_t micros) {
+    if (micros <= KEYBED_TRAVEL_FASTEST_MICROS) {
+        return 127;
+    }
+    if (micros >= KEYBED_TRAVEL_SLOWEST_MICROS) {
+        return 1;
+    }
+    static const float range = logf((float)KEYBED_TRAVEL_SLOWEST_MICROS / KEYBED_TRAVEL_FASTEST_MICROS);
+    float position = logf((float)KEYBED_TRAVEL_SLOWEST_MICROS / micros) / range;
+    return 1 + (int)(126 * position + 0.5f);
 }
 
-void Keybed::updateKey(const int key, const MatrixLevel currentLevel) {
+void Keybed::updateKey(const int key, const MatrixLevel currentLevel, uint32_t atMicros) {
     const MatrixLevel& lastLevel = lastMatrixLevels[key];
 
     if (currentLevel == MatrixLevel::OPEN) {
@@ -42,7 +77,7 @@ void Keybed::updateKey(const int key, const MatrixLevel currentLevel) {
     }
 
     if (currentLevel == MatrixLevel::FIRST && lastLevel == MatrixLevel::OPEN) {
-        travelStarts[key] = millis();
+        travelStarts[key] = atMicros | 1;  // zero is invalid
     }
 
     if (currentLevel == MatrixLevel::BOTH && lastLevel != currentLevel) {
@@ -50,8 +85,7 @@ void Keybed::updateKey(const int key, const MatrixLevel currentLevel) {
         int velocity = 127;
         if (travelStarts[key] > 0) {
             // is valid
-            uint32_t deltaMillis = millis() - travelStarts[key];
-            velocity = calculateVelocity(deltaMillis);
+            velocity = calculateVelocity(atMicros - travelStarts[key]);
         }
 
         if (isSustaining) {
@@ -59,11 +93,10 @@ void Keybed::updateKey(const int key, const MatrixLevel currentLevel) {
             if (handleKeyUp) {
                 handleKeyUp(key);
             }
-            uint32_t retriggerTime = 10;
-            scheduledKeyDowns.push_back({key, velocity, millis() + retriggerTime});
+            scheduleKeyDown(key, velocity, atMicros + KEYBED_RETRIGGER_MICROS);
         } else {
             // play now
-            scheduledKeyDowns.push_back({key, velocity, millis()});
+            scheduleKeyDown(key, velocity, atMicros);
         }
 
         keyStates[key] = KeyStates::PRESSED;
@@ -84,97 +117,166 @@ void Keybed::updateKey(const int key, const MatrixLevel currentLevel) {
     lastMatrixLevels[key] = currentLevel;
 }
 
+void Keybed::scheduleKeyDown(int key, int velocity, uint32_t dueMicros) {
+    if (!scheduledKeyDowns.schedule(dueMicros, {(uint8_t)key, (uint8_t)velocity})) {
+        // only if a key bounced faster than the retrigger delay, play it now
+        if (handleKeyDown) {
+            handleKeyDown(key, velocity);
+        }
+    }
+}
+
+// two hot bits for both matrices of the keyboard through the SRs
+static const SPIDevice keyboardDevice = {SPI_DEVICE_KEYBED, keyboardSPISettings, PIN_KYBD_CS, SPI_PRIORITY_KEYBED, 1, 0, 0};
+
+Keybed* Keybed::scanning = nullptr;
+
+void Keybed::scanTickStatic() {
+    if (scanning) scanning->scanTick();
+}
+
 void Keybed::init() {
+    buildContactBits();
     for (int i = 0; i < NUM_KEYS; i++) {
         lastMatrixLevels[i] = MatrixLevel::OPEN;
     }
     for (int i = 0; i < NUM_KEYS; i++) {
         keyStates[i] = KeyStates::OPEN;
     }
+
+    if (scanning && scanning != this) {
+        scanning->end();
+    }
+    scanRow = scanColumn = 0;
+    rowSelected = rowRequested = false;
+    firstContacts = secondContacts = 0;
+    scanning = this;
+    // the first tick selects a row
+    scanTimer.begin(scanTickStatic, KEYBED_ROW_TICK_MICROS);
 }
 
-void Keybed::update() {
-    isSustaining = !digitalRead(PIN_FTSW);
+void Keybed::end() {
+    scanTimer.end();
+    if (scanning == this) {
+        scanning = nullptr;
+    }
+}
 
-    MatrixLevel levels[NUM_KEYS];
-    for (int i = 0; i < NUM_KEYS; i++) {
-        levels[i] = MatrixLevel::OPEN;
+void Keybed::selectRow(int row) {
+    uint16_t twoHotRow = (uint16_t)(((1 << 8) | 1) << row);
+    rowRequested = spiBus.submit(keyboardDevice, &twoHotRow, 1, &rowTicket);
+}
+
+void Keybed::selectColumn(int column) {
+    digitalWrite(PIN_KYBD_MUX_A, column & 4);
+    digitalWrite(PIN_KYBD_MUX_B, column & 2);
+    digitalWrite(PIN_KYBD_MUX_C, column & 1);
+}
+
+// interrupt, reads the column selected on the previous tick and selects the next
+void Keybed::scanTick() {
+    if (!rowSelected) {
+        if (!rowRequested) {
+            selectRow(scanRow);
+        }
+        spiBus.service(SPI_PRIORITY_KEYBED);
+        if (!rowRequested || !spiBus.isDone(rowTicket)) {
+            return;  // main loop holds the shared bus and shifts the row out after its transaction
+        }
+        rowRequested = false;
+        scanTimer.update(KEYBED_TICK_MICROS);  // from the tick of column 0 on
+        selectColumn(0);
+        scanColumn = 0;
+        rowSelected = true;
+        return;
     }
 
-    for (int row = 0; row < 8; row++) {
-        enterCritical();
-        spiWrapper.beginTransaction(keyboardSPISettings);
-        digitalWrite(PIN_KYBD_CS, LOW);
-        delayMicroseconds(1);
-        // send two hot bits for both matrices of the keyboard through the SRs
-        uint16_t twoHotRow = (uint16_t)(((1 << 8) | 1) << row);
-        spiWrapper.transfer16(twoHotRow);
-        digitalWrite(PIN_KYBD_CS, HIGH);
-        spiWrapper.endTransaction();
-        exitCritical();
+    uint32_t now = micros();
+    uint64_t sampledFirst = 0, sampledSecond = 0, first = 0, second = 0;
+    for (int bank = 0; bank < 2; bank++) {
+        uint64_t firstBits = firstContactBits[bank][scanRow][scanColumn];
+        uint64_t secondBits = secondContactBits[bank][scanRow][scanColumn];
+        sampledFirst |= firstBits;
+        sampledSecond |= secondBits;
+        if (digitalRead(keyMatrixInputs[bank])) {
+            first |= firstBits;
+            second |= secondBits;
+        }
+    }
 
-        // read inputs
-        for (int column = 0; column < 8; column++) {
-            digitalWrite(PIN_KYBD_MUX_A, column & 4);
-            digitalWrite(PIN_KYBD_MUX_B, column & 2);
-            digitalWrite(PIN_KYBD_MUX_C, column & 1);
+    // only keys whose contacts changed
+    uint64_t lastFirst = firstContacts, lastSecond = secondContacts;
+    uint64_t changed = ((first ^ lastFirst) & sampledFirst) | ((second ^ lastSecond) & sampledSecond);
+    lastFirst = (lastFirst & ~sampledFirst) | first;
+    lastSecond = (lastSecond & ~sampledSecond) | second;
+    firstContacts = lastFirst;
+    secondContacts = lastSecond;
+    while (changed) {
+        int key = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        if (!events.push({(uint8_t)key, contactLevel(lastFirst, lastSecond, key), now})) {
+            eventsDropped = true;
+        }
+    }
+
+    scanColumn++;
+    if (scanColumn < 8) {
+        selectColumn(scanColumn);
+    } else {
+        scanRow = (scanRow + 1) % 8;
+        rowSelected = false;
+        scanTimer.update(KEYBED_ROW_TICK_MICROS);  // from the row tick on
+    }
+}
 
-            delayMicroseconds(20);
-            // delayMicroseconds(5);
+void Keybed::update() {
+    ProfileScope profile(PROF_KEYBED_UPDATE);
 
-            for (int bank = 0; bank < 2; bank++) {
-                int button = keyMatrices[bank][row][column];
-                if (button < 0) {
-                    // unused address in button matrix
-                    continue;
-                }
-
-                if (digitalRead(keyMatrixInputs[bank])) {
-                    if (button >= 100) {
-                        // is second trigger
-                        levels[button - 100] = MatrixLevel::BOTH;
-                    } else if (levels[button] != MatrixLevel::BOTH) {
-                        // is first trigger (ensure not to clear previous set level 2)
-                        levels[button] = MatrixLevel::FIRST;
-                    }
-                }
-            }
+    bool wasSustaining = isSustaining;
+    isSustaining = !digitalRead(PIN_FTSW);
+    uint32_t now = micros();
+
+    // sustain changes affect all released keys
+    if (isSustaining != wasSustaining) {
+        for (int key = 0; key < NUM_KEYS; key++) {
+            updateKey(key, lastMatrixLevels[key], now);
         }
     }
 
-    for (int i = 0; i < NUM_KEYS; i++) {
-        updateKey(i, levels[i]);
+    KeyEvent event;
+    while (events.pop(event)) {
+        updateKey(event.key, event.level, event.micros);
     }
 
-    // triggering
-    uint32_t currentMillis = millis();
-    for (auto iter = scheduledKeyDowns.begin(); iter != scheduledKeyDowns.end();) {
-        if (iter->timeMillis <= currentMillis) {
-            // trigger
-            if (handleKeyDown) {
-                handleKeyDown(iter->key, iter->velocity);
-            }
-            iter = scheduledKeyDowns.erase(iter);
-        } else {
-            iter++;
+    if (eventsDropped) {
+        // queue overflowed, catch up with the current contacts
+        noInterrupts();
+        uint64_t first = firstContacts, second = secondContacts;
+        eventsDropped = false;
+        interrupts();
+        for (int key = 0; key < NUM_KEYS; key++) {
+            updateKey(key, contactLevel(first, second, key), now);
         }
     }
+
+    // triggering
+    scheduledKeyDowns.popDue(micros(), [this](const KeyDownSchedule& s) {
+        if (handleKeyDown) {
+            handleKeyDown(s.key, s.velocity);
+        }
+    });
 }
 
 void Keybed::test() {
     bool somethingPressed = false;
+    end();  // blocking scan instead of the interrupt
 
     for (int row = 0; row < 8; row++) {
-        enterCritical();
-        spiWrapper.beginTransaction(keyboardSPISettings);
-        digitalWrite(PIN_KYBD_CS, LOW);
-        delayMicroseconds(1);
-        // send two hot bits for both matrices of the keyboard through the SRs
         uint16_t twoHotRow = (uint16_t)(((1 << 8) | 1) << row);
-        spiWrapper.transfer16(twoHotRow);
-        digitalWrite(PIN_KYBD_CS, HIGH);
-        spiWrapper.endTransaction();
-        exitCritical();
+        SPITicket ticket;
+        if (spiBus.submit(keyboardDevice, &twoHotRow, 1, &ticket)) {
+            spiBus.wait(ticket);
+        }
 
         // read inputs
         for (int column = 0; column < 8; column++) {
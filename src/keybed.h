@@ -1,6 +1,11 @@
+#pragma once
+#include <IntervalTimer.h>
+
 #include <cstdint>
-#include <map>
-#include <vector>
+
+#include "SPIBus.h"
+#include "spscqueue.h"
+#include "timerwheel.h"
 
 constexpr int NUM_KEYS = 61;
 
@@ -17,27 +22,82 @@ enum class KeyStates {
 };
 
 struct KeyDownSchedule {
-    int key, velocity;
-    uint32_t timeMillis;
+    uint8_t key, velocity;
+};
+
+// contact change seen by the scanner
+struct KeyEvent {
+    uint8_t key;
+    MatrixLevel level;
+    uint32_t micros;  // when the changed contact was sampled
 };
 
+// delay of the key down after the key up when retriggering a sustained key
+#define KEYBED_RETRIGGER_MICROS 10000
+// clock of the row select shift registers
+#define KEYBED_SPI_CLOCK SPI_BITBANG_CLOCK
+// one mux column per tick, also the settling time of the mux
+#define KEYBED_TICK_MICROS 20
+// the row select word and the cs setup, shifted out on its own longer tick.
+// column 0 is selected after the shift and still needs the full mux settling
+#define KEYBED_ROW_MICROS (16 * 1000000 / KEYBED_SPI_CLOCK + 1)
+#define KEYBED_ROW_TICK_MICROS (KEYBED_ROW_MICROS + KEYBED_TICK_MICROS)
+// every contact is sampled once per scan, the resolution of the travel time
+#define KEYBED_SCAN_MICROS (8 * (8 * KEYBED_TICK_MICROS + KEYBED_ROW_TICK_MICROS))
+// first to second contact of the fastest and the slowest strike, velocity 127 and 1
+#define KEYBED_TRAVEL_FASTEST_MICROS 2000
+#define KEYBED_TRAVEL_SLOWEST_MICROS 120000
+#define KEYBED_EVENT_QUEUE_SIZE 256
+
+/**
+ * The matrix is scanned from a timer interrupt, one column per tick and one
+ * longer tick per row to shift the row select, so a full scan takes 72 ticks
+ * and nothing waits for the mux to settle. The timer period is switched
+ * ahead of the row tick, as update() only takes effect after the current
+ * period. Contact changes are timestamped
+ * when sampled and queued for update(), which does all the note logic in the
+ * main loop.
+ */
 class Keybed {
+    static Keybed* scanning;  // one keyboard, the last initialized keybed scans it
+    static void scanTickStatic();
+
+    IntervalTimer scanTimer;
+    SpscQueue<KeyEvent, KEYBED_EVENT_QUEUE_SIZE> events;
+    volatile bool eventsDropped = false;
+
+    // scanner state, owned by the interrupt
+    int scanRow = 0, scanColumn = 0;
+    bool rowSelected = false;
+    bool rowRequested = false;  // queued on the bus, selected once done
+    SPITicket rowTicket;
+    // contacts closed as last sampled, bit i is key i
+    volatile uint64_t firstContacts = 0, secondContacts = 0;
+    void scanTick();
+    void selectRow(int row);
+    void selectColumn(int column);
+
     MatrixLevel lastMatrixLevels[NUM_KEYS];
     uint32_t travelStarts[NUM_KEYS];
     KeyStates keyStates[NUM_KEYS];
-    std::vector<KeyDownSchedule> scheduledKeyDowns;
-    void updateKey(int key, MatrixLevel currentLevel);
+    // one pending key down per key, by due time in micros
+    TimerWheel<KeyDownSchedule, NUM_KEYS> scheduledKeyDowns;
+    void scheduleKeyDown(int key, int velocity, uint32_t dueMicros);
+    void updateKey(int key, MatrixLevel currentLevel, uint32_t atMicros);
     void (*handleKeyDown)(int key, int velocity) = nullptr;
     void (*handleKeyUp)(int key) = nullptr;
     bool isSustaining = false;
 
    public:
+    // starts the scan interrupt
     void init();
+    void end();
+    // handles the queued contact changes, fires key callbacks
     void update();
     void test();
 
     void setHandleKeyDown(void (*callback)(int key, int velocity));
     void setHandleKeyUp(void (*callback)(int key));
 
-    const KeyStates* Keybed::getKeyStates() const;
+    const KeyStates* getKeyStates() const;
 };
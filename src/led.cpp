@@ -1,7 +1,11 @@
 #include "led.h"
 
-#include "SPIWrapper.h"
+#include "SPIBus.h"
 #include "config.h"
+#include "profiler.h"
+
+// shift registers latch on the rising edge of rclk
+static const SPIDevice ledDevice = {SPI_DEVICE_LEDS, ledSPISettings, PIN_P_SR_RCLK, SPI_PRIORITY_LEDS, 5, 5, 0};
 
 void PanelLedController::update(float dt) {
     timeSinceSwitch += dt;
@@ -11,7 +15,7 @@ void PanelLedController::update(float dt) {
     }
 }
 
-void PanelLedController::write() {
+uint32_t PanelLedController::shiftRegisterWord() const {
     int ledMapping[] = {
         0,  // 0
         LED_BEND_OCT,
@@ -58,17 +62,16 @@ void PanelLedController::write() {
             }
         }
     }
+    return buf;
+}
+
+void PanelLedController::write() {
+    ProfileScope profile(PROF_LEDS_WRITE);
 
-    enterCritical();
-    spiWrapper.beginTransaction(ledSPISettings);
-    digitalWrite(PIN_P_SR_RCLK, LOW);
-    delayMicroseconds(5);  // idk
-    spiWrapper.transfer16(buf >> 16);
-    spiWrapper.transfer16(buf);
-    delayMicroseconds(5);
-    digitalWrite(PIN_P_SR_RCLK, HIGH);
-    spiWrapper.endTransaction();
-    exitCritical();
+    uint32_t buf = shiftRegisterWord();
+    uint16_t words[2] = {(uint16_t)(buf >> 16), (uint16_t)buf};
+    spiBus.submit(ledDevice, words, 2);
+    spiBus.service();
 }
 
 void PanelLedController::setAll(LedModes mode) {
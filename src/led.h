@@ -49,6 +49,8 @@ struct PanelLedController {
    public:
     void update(float dt);
     void write();
+    // outputs of the shift registers, bit 31 is shifted first
+    uint32_t shiftRegisterWord() const;
     void setAll(LedModes mode);
     void setAllNumbers(LedModes mode);
     void setSingle(PanelLeds led, LedModes mode);
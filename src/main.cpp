@@ -1,32 +1,22 @@
 #include <Arduino.h>
 
-#include <climits>
-
+#include "SPIBus.h"
 #include "SPIWrapper.h"
 #include "StableTimer.h"
 #include "config.h"
+#include "dacs.h"
 #include "instrument.h"
+#include "keybed.h"
 #include "led.h"
 #include "memory.h"
 #include "midis.h"
 #include "panel.h"
 #include "player.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "tasks.h"
 #include "utils.h"
 
-PanelLedController leds;
-Instrument instr(leds);
-Player player(instr, leds);
-Panel panel(instr, player, leds);
-
-// uint32_t clockIn, uint8_t bitOrderIn, uint8_t dataModeIn
-SPIWrapperSettings ledSPISettings(100000, MSBFIRST, SPI_MODE0, PIN_P_MOSI, PIN_P_SCK);
-SPIWrapperSettings dacSPISettings(100000, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK);
-SPIWrapperSettings mcp4802Settings(100000, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK);
-SPIWrapperSettings pga2311Settings(100000, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK);
-SPIWrapperSettings keyboardSPISettings(100000, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK);
-
-StableTimer clockTimer;
-
 void pin_setup() {
     // seperate bitbanged pseudo-SPI line for whacky panel
 
@@ -153,49 +143,50 @@ void setup() {
     instr.getPatch() = firstPatch;
 
     // init_test_all();
+
+    scheduler_setup();
 }
 
-unsigned long previousMicros = 0;
+// single character commands over usb serial
+void serial_commands() {
+    while (Serial.available() > 0) {
+        int command = Serial.read();
+        switch (command) {
+            case 'p':
+                profiler_print();
+                scheduler.print();
+                dacs_print_stats();
+                spiBus.printStats();
+                clockTimer.printStats();
+                player.printClockStats();
+                break;
+            case 'r':
+                profiler_reset();
+                spiBus.resetStats();
+                clockTimer.resetStats();
+                player.resetClockStats();
+                break;
+            case 't':
+                spiWrapper.printTrace();
+                break;
+        }
+    }
+}
 
-float pastTime = 0;
-float secondCounter;
-int lastSecondPrint = 0;
+uint32_t lastLoopPrintMillis = 0;
 int loopCounter = 0;
 
-int lastSecondsInt = 0;
-
 void loop() {
-    unsigned long currentMicros, elapsedTimeMicros;
-    currentMicros = micros();
-    if (currentMicros >= previousMicros) {
-        elapsedTimeMicros = currentMicros - previousMicros;
-    } else {
-        elapsedTimeMicros = (ULONG_MAX - previousMicros) + currentMicros + 1;
-    }
-    previousMicros = currentMicros;
-    float dt = elapsedTimeMicros / 1000000.0;
-    pastTime += dt;
-    secondCounter += dt;
-
-    int secondsInt = (int)secondCounter;
-    if (secondsInt - lastSecondPrint >= 10) {
-        debugprintf("%u seconds, %d loops\n", secondsInt, loopCounter);
-        lastSecondPrint = secondsInt;
+    uint32_t currentMillis = millis();
+    if (currentMillis - lastLoopPrintMillis >= 10000) {
+        debugprintf("%u seconds, %d loops\n", currentMillis / 1000, loopCounter);
+        lastLoopPrintMillis = currentMillis;
         loopCounter = 0;
     }
     loopCounter++;
 
-    panel.read();
-    panel.update();
-
-    player.update(dt);
-
-    instr.update(dt);
-    instr.write();
-    delayMicroseconds(5000);
-
-    leds.update(dt);
-    leds.write();
+    serial_commands();
 
-    // printf("PIN_FTSW=%d\n", digitalRead(PIN_FTSW));
+    // runs the most overdue stage, returns right away if none is due
+    scheduler.runNext();
 }
@@ -5,14 +5,29 @@
 #include "instrument.h"
 
 struct MemoryBlockTuning {
-    TuningCorrection corrections[8][2];
+    // parabola of each TuningCorrection, layout predates the splines
+    float corrections[8][2][3];
     float pitchBendCenter, modCenter;
 };
 
+#define MEMORY_SPLINES_MAGIC 0x5350
+
+// written after the presets, ignored if the magic or knot count differ
+struct MemoryBlockSplines {
+    uint16_t magic;
+    uint16_t knots;
+    TuningSpline splines[8][2];
+};
+
 #define MEMORY_TUNING_START_ADDRESS 0
 #define MEMORY_TUNING_SECTION_SIZE (sizeof(MemoryBlockTuning))
 
 #define MEMORY_PRESETS_START_ADDRESS MEMORY_TUNING_SECTION_SIZE
+#define MEMORY_PRESETS_COUNT 16
+
+#define MEMORY_SPLINES_START_ADDRESS (MEMORY_PRESETS_START_ADDRESS + MEMORY_PRESETS_COUNT * sizeof(Patch))
+
+static_assert(MEMORY_SPLINES_START_ADDRESS + sizeof(MemoryBlockSplines) <= E2END + 1, "eeprom full");
 
 void memory_load_buffer(uint8_t* dest, size_t eeprom_addr, size_t count);
 void memory_save_buffer(uint8_t* src, size_t eeprom_addr, size_t count);
@@ -3,6 +3,7 @@
 #include <Arduino.h>
 
 #include "config.h"
+#include "profiler.h"
 
 MIDI_CREATE_INSTANCE(HardwareSerial, Serial8, MIDI);
 
@@ -11,6 +12,8 @@ void midiInit() {
 }
 
 void midiRead(int channel) {
+    ProfileScope profile(PROF_MIDI_READ);
+
     while (MIDI.read(channel));
     while (usbMIDI.read(channel));
 }
@@ -5,6 +5,7 @@
 
 #include "config.h"
 #include "memory.h"
+#include "profiler.h"
 #include "utils.h"
 
 #define USE_TOGGLE(S, T) \
@@ -22,6 +23,8 @@ Panel::Panel(Instrument& instr, Player& player, PanelLedController& leds)
 #define PANEL_MUX_IDLE_MICROS 100
 
 void Panel::read() {
+    ProfileScope profile(PROF_PANEL_READ);
+
     digitalWrite(PIN_P_MUX_A, LOW);
     digitalWrite(PIN_P_MUX_B, LOW);
     digitalWrite(PIN_P_MUX_C, LOW);
@@ -377,6 +380,8 @@ int min(int a, int b) {
 }
 
 void Panel::update() {
+    ProfileScope profile(PROF_PANEL_UPDATE);
+
     // patch stuff:
     // ____Active array must get all set to false if patch gets loaded from somewhere
 
@@ -437,7 +442,9 @@ void Panel::update() {
     if (isClicked(SW_MIDI_SYNC)) {
         player.resetClockProgress();
     }
-    leds.setSingle(LED_MIDI_CLOCK, playerSettings[PLS_MIDICLOCK] ? LED_MODE_ON : LED_MODE_OFF);
+    // blinks while the external clock is not locked
+    LedModes midiClockLed = player.getMidiClockStatus().locked ? LED_MODE_ON : LED_MODE_BLINK;
+    leds.setSingle(LED_MIDI_CLOCK, playerSettings[PLS_MIDICLOCK] ? midiClockLed : LED_MODE_OFF);
 
     playerSettings[PLS_RATE] = faders[FD_CTRL_RATE].current;
     playerSettings[PLS_ARP_MODE] = switches[SW_ARP_MODE].current;
@@ -0,0 +1,133 @@
+#include "period.h"
+
+#include <cmath>
+
+#include "profiler.h"
+
+void PeriodEstimator::begin(float tolerance) {
+    toleranceCents = tolerance;
+    queueRead = queueWrite;
+    queueOverflows = 0;
+    rejected = 0;
+    resetFit();
+}
+
+void PeriodEstimator::resetFit() {
+    bootstrapCount = 0;
+    firstTimestamp = lastTimestamp = 0;
+    lastIndex = 0;
+    period = 0;
+    count = 0;
+    meanK = meanT = ckk = ckt = ctt = 0;
+    rejectedSinceBootstrap = 0;
+}
+
+void PeriodEstimator::addEdge(uint32_t timestamp) {
+    uint32_t write = queueWrite;
+    if (write - queueRead >= PERIOD_QUEUE_SIZE) {
+        queueOverflows = queueOverflows + 1;  // looks like a missed edge to the fit
+        return;
+    }
+    queue[write % PERIOD_QUEUE_SIZE] = timestamp;
+    queueWrite = write + 1;
+}
+
+bool PeriodEstimator::process() {
+    uint32_t write = queueWrite;
+    while (queueRead != write) {
+        uint32_t timestamp = queue[queueRead % PERIOD_QUEUE_SIZE];
+        queueRead++;
+
+        if (bootstrapCount < PERIOD_BOOTSTRAP_EDGES) {
+            bootstrap[bootstrapCount++] = timestamp;
+            if (bootstrapCount == PERIOD_BOOTSTRAP_EDGES) {
+                finishBootstrap();
+            }
+        } else {
+            acceptEdge(timestamp);
+        }
+    }
+    return getEstimate().converged;
+}
+
+// median interval of the first edges, robust against a few missed or spurious ones
+void PeriodEstimator::finishBootstrap() {
+    uint32_t intervals[PERIOD_BOOTSTRAP_EDGES - 1];
+    int n = PERIOD_BOOTSTRAP_EDGES - 1;
+    for (int i = 0; i < n; i++) {
+        uint32_t interval = bootstrap[i + 1] - bootstrap[i];
+        int j = i;
+        for (; j > 0 && intervals[j - 1] > interval; j--) {
+            intervals[j] = intervals[j - 1];
+        }
+        intervals[j] = interval;
+    }
+    period = 0.5 * ((double)intervals[(n - 1) / 2] + intervals[n / 2]);
+
+    firstTimestamp = lastTimestamp = bootstrap[0];
+    lastIndex = 0;
+    addSample(0, bootstrap[0]);
+    // stops if the fit was reset
+    for (int i = 1; i < PERIOD_BOOTSTRAP_EDGES && bootstrapCount > 0; i++) {
+        acceptEdge(bootstrap[i]);
+    }
+}
+
+void PeriodEstimator::acceptEdge(uint32_t timestamp) {
+    double cycles = (uint32_t)(timestamp - lastTimestamp) / period;
+    int32_t steps = (int32_t)lround(cycles);
+    if (steps < 1 || fabs(cycles - steps) > PERIOD_OUTLIER_TOLERANCE) {
+        rejected++;
+        rejectedSinceBootstrap++;
+        if (rejectedSinceBootstrap > count) {
+            resetFit();  // bootstrap period was wrong, most edges do not fit it
+        }
+        return;
+    }
+    lastIndex += steps;
+    lastTimestamp = timestamp;
+    addSample(lastIndex, timestamp);
+
+    if (count >= PERIOD_MIN_EDGES) {
+        period = ckt / ckk;  // follow the fit
+    }
+}
+
+void PeriodEstimator::addSample(int32_t index, uint32_t timestamp) {
+    // welford style updates, timestamps relative to the first edge
+    double k = index;
+    double t = (uint32_t)(timestamp - firstTimestamp);
+    count++;
+    double dk = k - meanK;
+    double dt = t - meanT;
+    meanK += dk / count;
+    meanT += dt / count;
+    ckk += dk * (k - meanK);
+    ckt += dk * (t - meanT);
+    ctt += dt * (t - meanT);
+}
+
+PeriodEstimate PeriodEstimator::getEstimate() const {
+    PeriodEstimate e;
+    e.frequency = 0;
+    e.cents = INFINITY;
+    e.edges = count;
+    e.rejected = rejected + queueOverflows;
+    e.converged = false;
+
+    if (count < 3 || ckk <= 0) {
+        return e;
+    }
+    double slope = ckt / ckk;
+    double residual = ctt - ckt * slope;
+    if (residual < 0) {
+        residual = 0;
+    }
+    double slopeError = sqrt(residual / (count - 2) / ckk);
+    double microsPerTick = profiler_ticks_to_micros(1000000) / 1e6;
+
+    e.frequency = 1e6 / (slope * microsPerTick);
+    e.cents = 1200 / M_LN2 * PERIOD_CONFIDENCE_Z * slopeError / slope;
+    e.converged = count >= PERIOD_MIN_EDGES && e.cents <= toleranceCents;
+    return e;
+}
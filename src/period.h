@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+
+// edges buffered between the interrupt and process()
+#define PERIOD_QUEUE_SIZE 128
+// intervals used to find the initial period
+#define PERIOD_BOOTSTRAP_EDGES 9
+#define PERIOD_MIN_EDGES 16
+// edges further than this from a whole number of periods are rejected
+#define PERIOD_OUTLIER_TOLERANCE 0.2
+// two standard errors, roughly 95 % confidence
+#define PERIOD_CONFIDENCE_Z 2.0
+
+struct PeriodEstimate {
+    float frequency;  // Hz, 0 until the first fit
+    float cents;      // half width of the confidence interval
+    int edges;        // edges used in the fit
+    int rejected;     // outliers and overflowed edges
+    bool converged;
+};
+
+/**
+ * Estimates the period of a square wave from edge timestamps. Every
+ * accepted edge gets the index of the period it belongs to and the period
+ * is the slope of a running least squares fit of timestamp over index.
+ * A missed edge only advances the index by two, spurious edges between
+ * periods are rejected. Converged once the confidence interval of the
+ * period is within the cent tolerance.
+ *
+ * addEdge() may be called from an interrupt, everything else from the
+ * main loop.
+ */
+class PeriodEstimator {
+    volatile uint32_t queue[PERIOD_QUEUE_SIZE];
+    volatile uint32_t queueWrite = 0;
+    volatile uint32_t queueOverflows = 0;
+    volatile uint32_t queueRead = 0;
+
+    uint32_t bootstrap[PERIOD_BOOTSTRAP_EDGES];
+    int bootstrapCount = 0;
+
+    uint32_t firstTimestamp = 0, lastTimestamp = 0;
+    int32_t lastIndex = 0;
+    double period = 0;  // ticks
+
+    // running means and co-moments of index k and time t
+    int count = 0;
+    double meanK = 0, meanT = 0, ckk = 0, ckt = 0, ctt = 0;
+    int rejected = 0;
+    int rejectedSinceBootstrap = 0;
+
+    float toleranceCents = 1;
+
+    void resetFit();
+    void addSample(int32_t index, uint32_t timestamp);
+    void acceptEdge(uint32_t timestamp);
+    void finishBootstrap();
+
+   public:
+    void begin(float toleranceCents);
+
+    // timestamp from profiler_timestamp()
+    void addEdge(uint32_t timestamp);
+    // fits the queued edges, returns true once converged
+    bool process();
+
+    PeriodEstimate getEstimate() const;
+};
@@ -281,6 +281,15 @@ void Player::clockTick(bool isMidi) {
     }
 }
 
+// main loop, from midiRead()
+void Player::handleMidiClock() {
+    midiClock.input(micros());
+}
+
+ClockFollowerStatus Player::getMidiClockStatus() const {
+    return midiClock.getStatus();
+}
+
 int Player::keyToNote(int key) {
     // input key: 0 - number of keys - 1
     // final pitch = C0 + note
@@ -292,6 +301,7 @@ void Player::setSongMode(SongMode mode) {
 }
 
 void Player::handleMidiStart() {
+    midiClock.reset();
     resetClockProgress();
     setSongMode(SongMode::Playing);
 }
@@ -353,12 +363,12 @@ void Player::init() {
         debugprintf("MIDI control change received %x %x %x\n", channel, control, value);
         Player::getInstance().handleMidiControlChange(channel, control, value);
     });
-    midiSetHandleClock([]() { Player::getInstance().clockTick(true); });
+    midiSetHandleClock([]() { Player::getInstance().handleMidiClock(); });
     midiSetHandleStart([]() { Player::getInstance().handleMidiStart(); });
     midiSetHandleStop([]() { Player::getInstance().handleMidiStop(); });
     midiSetHandleContinue([]() { Player::getInstance().handleMidiContinue(); });
 
-    clockTimer.begin([]() { Player::getInstance().clockTick(false); });
+    clockTimer.begin([]() { Player::getInstance().pushClockTick(); });
 
     keybed.setHandleKeyDown([](int key, int velocity) {
         int note = Player::getInstance().keyToNote(key);
@@ -373,8 +383,59 @@ void Player::init() {
     keybed.init();
 }
 
+// interrupt, timestamps the tick for the main loop
+void Player::pushClockTick() {
+    if (!clockTicks.push(micros())) {
+        owedClockTicks = owedClockTicks + 1;
+    }
+}
+
+void Player::drainClockTicks() {
+    uint32_t now = micros();
+    uint32_t tickMicros;
+    while (clockTicks.pop(tickMicros)) {
+        clockStats.ticks++;
+        clockStats.deferredMicros += now - tickMicros;
+        clockStats.maxLatencyMicros = std::max(clockStats.maxLatencyMicros, now - tickMicros);
+        clockTick(false);
+    }
+
+    noInterrupts();
+    uint32_t owed = owedClockTicks;
+    owedClockTicks = 0;
+    interrupts();
+    for (uint32_t i = 0; i < owed; i++) {
+        clockStats.ticks++;
+        clockStats.owed++;
+        clockTick(false);
+    }
+}
+
+const ClockStats& Player::getClockStats() const {
+    return clockStats;
+}
+
+void Player::resetClockStats() {
+    clockStats = ClockStats();
+}
+
+void Player::printClockStats() {
+    printf("clock: %lu ticks played, %lu owed, %.1f us mean and %lu us max deferral\n",
+           (unsigned long)clockStats.ticks, (unsigned long)clockStats.owed,
+           clockStats.ticks ? (double)clockStats.deferredMicros / clockStats.ticks : 0.0,
+           (unsigned long)clockStats.maxLatencyMicros);
+    ClockFollowerStatus midi = midiClock.getStatus();
+    printf("midi clock: %s, %.1f bpm, %.0f us mean phase error, %lu relocks\n",
+           midi.locked ? "locked" : "unlocked", midi.bpm, midi.errorMicros, (unsigned long)midi.relocks);
+}
+
 void Player::update(float dt) {
+    // all events from interrupts are handled here, before midi and keys
+    drainClockTicks();
     midiRead(midiChannel);
+    while (midiClock.poll(micros())) {
+        clockTick(true);
+    }
 
     keybed.update();
 
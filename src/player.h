@@ -1,14 +1,27 @@
 #pragma once
 #include <cstdint>
 
+#include "clockfollower.h"
 #include "instrument.h"
 #include "keybed.h"
 #include "led.h"
+#include "spscqueue.h"
 
 #define NOTE_BUFFER_MAX_SIZE 256
 
 #define MIDI_SEND_CHANNEL 5
 
+// internal clock ticks waiting for the main loop
+#define CLOCK_QUEUE_SIZE 16
+
+struct ClockStats {
+    uint32_t ticks = 0;
+    uint32_t owed = 0;  // ticks which found the queue full, still played
+    // time from the interrupt until the main loop played the tick
+    uint64_t deferredMicros = 0;
+    uint32_t maxLatencyMicros = 0;
+};
+
 enum PlayerState {
     PLSTATE_NORMAL,
     PLSTATE_ARP,
@@ -60,12 +73,23 @@ class Player {
 
     SongMode songMode = SongMode::Playing;
 
+    // filled by the clock timer interrupt, drained at the start of update()
+    SpscQueue<uint32_t, CLOCK_QUEUE_SIZE> clockTicks;
+    volatile uint32_t owedClockTicks = 0;
+    ClockStats clockStats;
+    void pushClockTick();
+    void drainClockTicks();
+
+    // smooths the external clock, its ticks are played from update()
+    ClockFollower midiClock;
+
     void setState(PlayerState nextState);
     void pushSequencerNote(int note);
     void setTransposition(int note);
     void step();
 
     void clockTick(bool isMidi);
+    void handleMidiClock();
     void handleNoteOn(int note, int velocity, bool isMidi);
     void handleNoteOff(int note, int velocity, bool isMidi);
     void handleMidiControlChange(uint8_t channel, uint8_t control, uint8_t value);
@@ -93,6 +117,10 @@ class Player {
     void setSongMode(SongMode mode);
     void updateArpSequence();
     int keyToNote(int key);
+    ClockFollowerStatus getMidiClockStatus() const;
+    const ClockStats& getClockStats() const;
+    void resetClockStats();
+    void printClockStats();
 
     Player(const Player&) = delete;
 };
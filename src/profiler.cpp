@@ -0,0 +1,108 @@
+#include "profiler.h"
+
+#include <Arduino.h>
+
+#ifndef ARM_DWT_CYCCNT
+#include <time.h>
+#endif
+
+static const char* stageNames[PROF__COUNT__] = {
+    "panel read",
+    "panel update",
+    "midi read",
+    "keybed update",
+    "instr update",
+    "dacs write",
+    "instr spi write",
+    "leds write",
+};
+
+static ProfilerStats stats[PROF__COUNT__];
+
+uint32_t profiler_timestamp() {
+#ifdef ARM_DWT_CYCCNT
+    return ARM_DWT_CYCCNT;  // enabled by the teensy startup code
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+
+float profiler_ticks_to_micros(uint32_t ticks) {
+#ifdef ARM_DWT_CYCCNT
+    return ticks / (F_CPU_ACTUAL / 1000000.0f);
+#else
+    return ticks / 1000.0f;
+#endif
+}
+
+static int bucketIndex(uint32_t ticks) {
+    if (ticks < PROFILER_SUB_BUCKETS) {
+        return ticks;
+    }
+    // position of highest bit selects the octave, the following 3 bits the sub bucket
+    int msb = 31 - __builtin_clz(ticks);
+    int sub = (ticks >> (msb - 3)) & (PROFILER_SUB_BUCKETS - 1);
+    return (msb - 2) * PROFILER_SUB_BUCKETS + sub;
+}
+
+// upper bound of ticks falling into bucket
+static uint32_t bucketLimit(int bucket) {
+    if (bucket < PROFILER_SUB_BUCKETS) {
+        return bucket;
+    }
+    int msb = bucket / PROFILER_SUB_BUCKETS + 2;
+    uint32_t sub = bucket % PROFILER_SUB_BUCKETS;
+    uint64_t limit = ((uint64_t)(PROFILER_SUB_BUCKETS + sub + 1) << (msb - 3)) - 1;
+    return limit > UINT32_MAX ? UINT32_MAX : (uint32_t)limit;
+}
+
+void profiler_record(ProfilerStage stage, uint32_t ticks) {
+    ProfilerStats& s = stats[stage];
+    s.count++;
+    s.sum += ticks;
+    if (ticks < s.min) s.min = ticks;
+    if (ticks > s.max) s.max = ticks;
+    s.histogram[bucketIndex(ticks)]++;
+}
+
+uint32_t profiler_percentile(ProfilerStage stage, float fraction) {
+    const ProfilerStats& s = stats[stage];
+    uint32_t target = (uint32_t)(fraction * s.count);
+    uint32_t cumulative = 0;
+    for (int i = 0; i < PROFILER_BUCKETS; i++) {
+        cumulative += s.histogram[i];
+        if (cumulative > target) {
+            return min(bucketLimit(i), s.max);
+        }
+    }
+    return s.max;
+}
+
+const ProfilerStats& profiler_get_stats(ProfilerStage stage) {
+    return stats[stage];
+}
+
+void profiler_reset() {
+    for (int i = 0; i < PROF__COUNT__; i++) {
+        stats[i] = ProfilerStats();
+    }
+}
+
+void profiler_print() {
+    printf("\n%-18s%10s%12s%12s%12s%12s\n", "stage [us]", "count", "min", "avg", "max", "p99");
+    for (int i = 0; i < PROF__COUNT__; i++) {
+        const ProfilerStats& s = stats[i];
+        if (s.count == 0) {
+            printf("%-18s%10d\n", stageNames[i], 0);
+            continue;
+        }
+        printf("%-18s%10lu%12.1f%12.1f%12.1f%12.1f\n",
+               stageNames[i], (unsigned long)s.count,
+               profiler_ticks_to_micros(s.min),
+               profiler_ticks_to_micros((uint32_t)(s.sum / s.count)),
+               profiler_ticks_to_micros(s.max),
+               profiler_ticks_to_micros(profiler_percentile((ProfilerStage)i, 0.99f)));
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+
+enum ProfilerStage {
+    PROF_PANEL_READ,
+    PROF_PANEL_UPDATE,
+    PROF_MIDI_READ,
+    PROF_KEYBED_UPDATE,
+    PROF_INSTR_UPDATE,
+    PROF_DACS_WRITE,
+    PROF_INSTR_SPI_WRITE,  // MCP4802 chorus and PGA2311 volume
+    PROF_LEDS_WRITE,
+    PROF__COUNT__,
+};
+
+// log-linear histogram, 8 buckets per power of two
+#define PROFILER_SUB_BUCKETS 8
+#define PROFILER_BUCKETS (32 * PROFILER_SUB_BUCKETS)
+
+struct ProfilerStats {
+    uint32_t count = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint64_t sum = 0;
+    uint32_t histogram[PROFILER_BUCKETS] = {};
+};
+
+// DWT cycle counter on the teensy, nanoseconds on a host
+uint32_t profiler_timestamp();
+float profiler_ticks_to_micros(uint32_t ticks);
+
+void profiler_record(ProfilerStage stage, uint32_t ticks);
+uint32_t profiler_percentile(ProfilerStage stage, float fraction);
+const ProfilerStats& profiler_get_stats(ProfilerStage stage);
+void profiler_reset();
+void profiler_print();
+
+class ProfileScope {
+    ProfilerStage stage;
+    uint32_t start;
+
+   public:
+    ProfileScope(ProfilerStage stage) : stage(stage), start(profiler_timestamp()) {}
+    ~ProfileScope() {
+        profiler_record(stage, profiler_timestamp() - start);
+    }
+};
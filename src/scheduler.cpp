@@ -0,0 +1,120 @@
+#include "scheduler.h"
+
+#include <Arduino.h>
+
+#include "config.h"
+
+static uint32_t defaultClock() {
+    return micros();
+}
+
+// wrap-around safe comparison of two timestamps
+static inline bool isBefore(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+Scheduler::Scheduler() : clock(defaultClock) {}
+
+void Scheduler::setClock(uint32_t (*clockFunc)()) {
+    clock = clockFunc ? clockFunc : defaultClock;
+    uint32_t now = clock();
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].nextRelease = now;
+        tasks[i].lastRun = now;
+    }
+}
+
+int Scheduler::addTask(const char* name, void (*callback)(float dt), uint32_t periodMicros, uint32_t deadlineMicros) {
+    if (taskCount >= SCHEDULER_MAX_TASKS) {
+        debugprintf("scheduler full, cannot add task %s\n", name);
+        return -1;
+    }
+    uint32_t now = clock();
+    SchedulerTask& task = tasks[taskCount];
+    task.name = name;
+    task.callback = callback;
+    task.periodMicros = periodMicros;
+    task.deadlineMicros = deadlineMicros > 0 ? deadlineMicros : periodMicros;
+    task.nextRelease = now;
+    task.lastRun = now;
+    return taskCount++;
+}
+
+void Scheduler::setTaskPeriod(int task, uint32_t periodMicros) {
+    if (task < 0 || task >= taskCount) {
+        return;
+    }
+    if (tasks[task].deadlineMicros == tasks[task].periodMicros) {
+        tasks[task].deadlineMicros = periodMicros;
+    }
+    tasks[task].periodMicros = periodMicros;
+}
+
+bool Scheduler::runNext() {
+    uint32_t now = clock();
+
+    // earliest deadline first among all released tasks
+    int next = -1;
+    uint32_t nextDeadline = 0;
+    for (int i = 0; i < taskCount; i++) {
+        SchedulerTask& task = tasks[i];
+        if (isBefore(now, task.nextRelease)) {
+            continue;  // not released yet
+        }
+        uint32_t deadline = task.nextRelease + task.deadlineMicros;
+        if (next < 0 || isBefore(deadline, nextDeadline)) {
+            next = i;
+            nextDeadline = deadline;
+        }
+    }
+
+    if (next < 0) {
+        return false;
+    }
+
+    SchedulerTask& task = tasks[next];
+    float dt = (now - task.lastRun) / 1000000.0f;
+    task.lastRun = now;
+    task.callback(dt);
+    task.runs++;
+
+    uint32_t finished = clock();
+    if (isBefore(nextDeadline, finished)) {
+        task.deadlineMisses++;
+    }
+    uint32_t cost = finished - now;
+    task.costSumMicros += cost;
+    if (cost > task.maxCostMicros) {
+        task.maxCostMicros = cost;
+    }
+
+    task.nextRelease += task.periodMicros;
+    if (!isBefore(now, task.nextRelease)) {
+        // more than a period behind, drop the missed releases instead of bursting
+        task.shedReleases += (now - task.nextRelease) / task.periodMicros + 1;
+        task.nextRelease = now + task.periodMicros;
+    }
+    return true;
+}
+
+void Scheduler::print() const {
+    printf("\n%-18s%10s%10s%10s%10s%10s%10s\n", "task", "period", "runs", "misses", "shed", "mean us", "max us");
+    float utilization = 0;
+    for (int i = 0; i < taskCount; i++) {
+        const SchedulerTask& task = tasks[i];
+        float mean = task.runs ? (float)task.costSumMicros / task.runs : 0;
+        utilization += mean / task.periodMicros;
+        printf("%-18s%10lu%10lu%10lu%10lu%10.1f%10lu\n", task.name, (unsigned long)task.periodMicros,
+               (unsigned long)task.runs, (unsigned long)task.deadlineMisses, (unsigned long)task.shedReleases,
+               mean, (unsigned long)task.maxCostMicros);
+    }
+    printf("scheduler utilization %.1f %% of the mean costs\n", 100 * utilization);
+}
+
+int Scheduler::getTaskCount() const {
+    return taskCount;
+}
+
+const SchedulerTask& Scheduler::getTask(int task) const {
+    return tasks[task];
+}
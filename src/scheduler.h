@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+
+#define SCHEDULER_MAX_TASKS 8
+
+struct SchedulerTask {
+    const char* name;
+    void (*callback)(float dt);
+    uint32_t periodMicros;
+    uint32_t deadlineMicros;  // relative to release
+    uint32_t nextRelease;
+    uint32_t lastRun;
+    uint32_t runs = 0;
+    uint32_t deadlineMisses = 0;
+    uint32_t shedReleases = 0;  // dropped while more than a period behind
+    // run time in clock micros, what the periods have to be sized from
+    uint32_t maxCostMicros = 0;
+    uint64_t costSumMicros = 0;
+};
+
+/**
+ * Cooperative earliest-deadline-first scheduler for the control loop.
+ * Every task is released once per period and must finish before its
+ * deadline. runNext() picks the released task with the earliest absolute
+ * deadline (the most overdue one) and returns immediately if nothing is due,
+ * so the loop never sleeps.
+ *
+ * Tasks are not preempted, so the periods have to leave room for the
+ * longest run of every other task. The measured cost of each task is kept
+ * next to its misses. A task which falls more than a period behind sheds
+ * the releases it missed instead of running them back to back.
+ */
+class Scheduler {
+    SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+    int taskCount = 0;
+    uint32_t (*clock)();
+
+   public:
+    Scheduler();
+
+    // clock must return a free running microsecond counter, defaults to micros()
+    void setClock(uint32_t (*clockFunc)());
+
+    // deadlineMicros of 0 means deadline equals period
+    int addTask(const char* name, void (*callback)(float dt), uint32_t periodMicros, uint32_t deadlineMicros = 0);
+    void setTaskPeriod(int task, uint32_t periodMicros);
+
+    // runs at most one task, returns false if no task was due
+    bool runNext();
+
+    void print() const;
+    int getTaskCount() const;
+    const SchedulerTask& getTask(int task) const;
+};
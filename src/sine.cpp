@@ -0,0 +1,7 @@
+#include "sine.h"
+
+constexpr SineTable sineTable;
+
+static_assert(sineTable.values[0] == 0.0f, "sine table start");
+static_assert(sineTable.values[SINE_TABLE_SIZE / 4] == 1.0f, "sine table peak");
+static_assert(sineTable.values[3 * SINE_TABLE_SIZE / 4] == -1.0f, "sine table trough");
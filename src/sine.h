@@ -1,32 +1,56 @@
 #pragma once
+#include <cmath>
+#include <cstdint>
 
-#define TABLE_SIZE 64
+#define SINE_TABLE_BITS 10
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+#define SINE_FRACTION_BITS (32 - SINE_TABLE_BITS)
 
-const float sineLookup[TABLE_SIZE] = {
-    0.0, 0.1, 0.2, 0.29, 0.38, 0.47, 0.56, 0.63, 0.71,
-    0.77, 0.83, 0.88, 0.92, 0.96, 0.98, 1., 1., 1.,
-    0.98, 0.96, 0.92, 0.88, 0.83, 0.77, 0.71, 0.63, 0.56,
-    0.47, 0.38, 0.29, 0.2, 0.1, 0., -0.1, -0.19, -0.29,
-    -0.38, -0.47, -0.56, -0.63, -0.71, -0.77, -0.83, -0.88, -0.92,
-    -0.96, -0.98, -1., -1., -1., -0.98, -0.96, -0.92, -0.88,
-    -0.83, -0.77, -0.71, -0.63, -0.56, -0.47, -0.38, -0.29, -0.2, -0.1};
+// a full period of the 32 bit phase accumulator is 2^32
+#define PHASE_QUARTER 0x40000000u
 
-inline float sineApprox(float& x) {
+// taylor series, x between -pi/2 and pi/2
+constexpr double sineSeries(double x) {
+    double term = x, sum = x;
+    for (int n = 1; n < 10; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
 
-    while (x < 0.0) x += M_TWOPI;
-    while (x >= M_TWOPI) x -= M_TWOPI;
+// x between 0 and 2pi
+constexpr double sineReference(double x) {
+    if (x > M_PI) {
+        return -sineReference(x - M_PI);
+    }
+    if (x > 0.5 * M_PI) {
+        x = M_PI - x;
+    }
+    return sineSeries(x);
+}
 
-    float t = (1.0f / M_TWOPI) * x;
+// one period plus a guard entry for interpolating the last segment
+struct SineTable {
+    float values[SINE_TABLE_SIZE + 1];
 
-    // lookup
-    int a = ((int)(TABLE_SIZE * t)) % TABLE_SIZE;
-    int b = (a + 1) % TABLE_SIZE;
-    float ya = sineLookup[a];
-    float yb = sineLookup[b];
+    constexpr SineTable() : values() {
+        for (int i = 0; i <= SINE_TABLE_SIZE; i++) {
+            values[i] = (float)sineReference(2 * M_PI * i / SINE_TABLE_SIZE);
+        }
+    }
+};
 
-    // interpolate
-    float X = TABLE_SIZE * t;
-    float f = X - truncf(X);
-    float y = (1 - f) * ya + f * yb;
-    return y;
-}
\ No newline at end of file
+extern const SineTable sineTable;
+
+// phase 0 to 2^32 maps to one period, wraps for free
+inline float sinePhase(uint32_t phase) {
+    uint32_t index = phase >> SINE_FRACTION_BITS;
+    float frac = (phase & ((1u << SINE_FRACTION_BITS) - 1)) * (1.0f / (1u << SINE_FRACTION_BITS));
+    float a = sineTable.values[index];
+    return a + (sineTable.values[index + 1] - a) * frac;
+}
+
+inline uint32_t phaseIncrement(float frequency, float dt) {
+    return (uint32_t)(int64_t)(frequency * dt * 4294967296.0f);
+}
@@ -0,0 +1,157 @@
+#include "spline.h"
+
+#include <cmath>
+
+void spline_reset(TuningSpline& spline) {
+    spline = TuningSpline();
+}
+
+bool spline_is_fitted(const TuningSpline& spline) {
+    return spline.spacing > 0;
+}
+
+static int16_t to_fixed(float semis) {
+    float v = roundf(semis * SPLINE_SCALE);
+    if (v < INT16_MIN) v = INT16_MIN;
+    if (v > INT16_MAX) v = INT16_MAX;
+    return (int16_t)v;
+}
+
+// symmetric positive definite, no pivoting needed
+static void solve(float A[SPLINE_KNOTS][SPLINE_KNOTS], float b[SPLINE_KNOTS], float x[SPLINE_KNOTS]) {
+    const int n = SPLINE_KNOTS;
+    for (int i = 0; i < n; i++) {
+        float diag = A[i][i];
+        for (int j = i; j < n; j++) {
+            A[i][j] /= diag;
+        }
+        b[i] /= diag;
+        for (int k = i + 1; k < n; k++) {
+            float factor = A[k][i];
+            for (int j = i; j < n; j++) {
+                A[k][j] -= factor * A[i][j];
+            }
+            b[k] -= factor * b[i];
+        }
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        x[i] = b[i];
+        for (int j = i + 1; j < n; j++) {
+            x[i] -= A[i][j] * x[j];
+        }
+    }
+}
+
+bool spline_fit(const float* x, const float* y, int count, TuningSpline& spline) {
+    const int n = SPLINE_KNOTS;
+    if (count < 2) {
+        return false;
+    }
+    float lo = x[0], hi = x[0];
+    for (int i = 1; i < count; i++) {
+        lo = fminf(lo, x[i]);
+        hi = fmaxf(hi, x[i]);
+    }
+    int16_t start = to_fixed(lo);
+    int16_t spacing = to_fixed((hi - lo) / (n - 1));
+    if (spacing <= 0) {
+        return false;
+    }
+    float startSemis = start / SPLINE_SCALE;
+    float spacingSemis = spacing / SPLINE_SCALE;
+
+    // normal equations of the offsets at the knots, samples interpolate linearly
+    float A[SPLINE_KNOTS][SPLINE_KNOTS] = {};
+    float b[SPLINE_KNOTS] = {};
+    for (int i = 0; i < count; i++) {
+        float position = (x[i] - startSemis) / spacingSemis;
+        position = fminf(fmaxf(position, 0), n - 1);
+        int k = (int)position;
+        if (k > n - 2) k = n - 2;
+        float t = position - k;
+        float offset = y[i] - x[i];
+        A[k][k] += (1 - t) * (1 - t);
+        A[k][k + 1] += (1 - t) * t;
+        A[k + 1][k] += (1 - t) * t;
+        A[k + 1][k + 1] += t * t;
+        b[k] += (1 - t) * offset;
+        b[k + 1] += t * offset;
+    }
+    float smoothing = SPLINE_SMOOTHING * count / n;
+    const float d[3] = {1, -2, 1};
+    for (int k = 0; k < n - 2; k++) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                A[k + i][k + j] += smoothing * d[i] * d[j];
+            }
+        }
+    }
+    float offsets[SPLINE_KNOTS];
+    solve(A, b, offsets);
+
+    spline.start = start;
+    spline.spacing = spacing;
+    int32_t last = INT32_MIN;
+    for (int k = 0; k < n; k++) {
+        int32_t base = start + k * spacing;
+        int32_t value = base + to_fixed(offsets[k]);
+        if (value < last) {
+            value = last;  // keep it monotone
+        }
+        int32_t offset = value - base;
+        if (offset < INT16_MIN) offset = INT16_MIN;
+        if (offset > INT16_MAX) offset = INT16_MAX;
+        spline.offsets[k] = (int16_t)offset;
+        last = base + offset;
+    }
+    return true;
+}
+
+static float knot_value(const TuningSpline& spline, int k) {
+    return (spline.start + k * spline.spacing + spline.offsets[k]) / SPLINE_SCALE;
+}
+
+static float secant(const TuningSpline& spline, int k) {
+    return (spline.offsets[k + 1] - spline.offsets[k]) / (float)spline.spacing + 1;
+}
+
+// fritsch-carlson, harmonic mean of the neighbouring secants
+static float tangent(const TuningSpline& spline, int k) {
+    if (k == 0) {
+        return secant(spline, 0);
+    }
+    if (k == SPLINE_KNOTS - 1) {
+        return secant(spline, SPLINE_KNOTS - 2);
+    }
+    float a = secant(spline, k - 1);
+    float b = secant(spline, k);
+    if (a * b <= 0) {
+        return 0;
+    }
+    return 2 / (1 / a + 1 / b);
+}
+
+float spline_evaluate(const TuningSpline& spline, float x) {
+    if (!spline_is_fitted(spline)) {
+        return x;
+    }
+    float spacing = spline.spacing / SPLINE_SCALE;
+    float position = (x - spline.start / SPLINE_SCALE) / spacing;
+    if (position <= 0) {
+        return knot_value(spline, 0) + position * spacing * tangent(spline, 0);
+    }
+    if (position >= SPLINE_KNOTS - 1) {
+        float beyond = position - (SPLINE_KNOTS - 1);
+        return knot_value(spline, SPLINE_KNOTS - 1) + beyond * spacing * tangent(spline, SPLINE_KNOTS - 1);
+    }
+
+    // cubic hermite on the segment
+    int k = (int)position;
+    float s = position - k;
+    float s2 = s * s;
+    float s3 = s2 * s;
+    return (2 * s3 - 3 * s2 + 1) * knot_value(spline, k) +
+           (s3 - 2 * s2 + s) * spacing * tangent(spline, k) +
+           (-2 * s3 + 3 * s2) * knot_value(spline, k + 1) +
+           (s3 - s2) * spacing * tangent(spline, k + 1);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+#define SPLINE_KNOTS 12
+// fixed point scale of knot positions and offsets, 1/256 semitone
+#define SPLINE_SCALE 256.0f
+// weight of the second difference penalty, keeps knots without samples in line
+#define SPLINE_SMOOTHING 0.5f
+
+/**
+ * Monotone piecewise cubic through equally spaced knots. The knot values are
+ * fitted by least squares as a linear spline and evaluated with Fritsch-Carlson
+ * tangents, so the curve never bends back between knots. Knots are stored as
+ * offsets from the identity, which keeps a profile within 28 bytes.
+ */
+struct TuningSpline {
+    int16_t start = 0;    // first knot
+    int16_t spacing = 0;  // zero if not fitted
+    int16_t offsets[SPLINE_KNOTS] = {};
+};
+
+void spline_reset(TuningSpline& spline);
+bool spline_is_fitted(const TuningSpline& spline);
+// fails and leaves the spline untouched if the samples cover too little range
+bool spline_fit(const float* x, const float* y, int count, TuningSpline& spline);
+// constant time segment lookup, linear beyond the outer knots
+float spline_evaluate(const TuningSpline& spline, float x);
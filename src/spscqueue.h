@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock free queue from a single producer to a single consumer, e.g. from an
+ * interrupt to the main loop. Each index is only written by one side, the
+ * fences order the item copy against the index update like in DoubleBuffer.
+ * Size must be a power of two.
+ */
+template <typename T, int Size>
+class SpscQueue {
+    static_assert((Size & (Size - 1)) == 0, "size must be a power of two");
+
+    T items[Size];
+    volatile uint32_t head = 0;  // written by the producer
+    volatile uint32_t tail = 0;  // written by the consumer
+
+   public:
+    // false if full, the item is dropped
+    bool push(const T& item) {
+        uint32_t h = head;
+        if (h - tail >= (uint32_t)Size) {
+            return false;
+        }
+        items[h & (Size - 1)] = item;
+        std::atomic_signal_fence(std::memory_order_release);
+        head = h + 1;
+        return true;
+    }
+
+    bool pop(T& item) {
+        uint32_t t = tail;
+        if (t == head) {
+            return false;
+        }
+        std::atomic_signal_fence(std::memory_order_acquire);
+        item = items[t & (Size - 1)];
+        std::atomic_signal_fence(std::memory_order_release);
+        tail = t + 1;
+        return true;
+    }
+
+    bool empty() const {
+        return tail == head;
+    }
+};
@@ -0,0 +1,56 @@
+#include "tasks.h"
+
+#include "SPIWrapper.h"
+#include "config.h"
+#include "keybed.h"
+
+PanelLedController leds;
+Instrument instr(leds);
+Player player(instr, leds);
+Panel panel(instr, player, leds);
+
+// clock, bit order, mode, mosi, sck
+SPIWrapperSettings ledSPISettings = bitbangSPISettings<SPI_BITBANG_CLOCK, MSBFIRST, SPI_MODE0, PIN_P_MOSI, PIN_P_SCK>();
+SPIWrapperSettings dacSPISettings = bitbangSPISettings<SPI_BITBANG_CLOCK, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK>();
+SPIWrapperSettings mcp4802Settings = bitbangSPISettings<SPI_BITBANG_CLOCK, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK>();
+SPIWrapperSettings pga2311Settings = bitbangSPISettings<SPI_BITBANG_CLOCK, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK>();
+SPIWrapperSettings keyboardSPISettings = bitbangSPISettings<KEYBED_SPI_CLOCK, MSBFIRST, SPI_MODE0, PIN_SPI_MOSI, PIN_SPI_SCK>();
+
+StableTimer clockTimer;
+Scheduler scheduler;
+
+void task_keybed(float dt) {
+    player.update(dt);
+}
+
+void task_instrument(float dt) {
+    instr.update(dt);
+    instr.writeAudioPath();
+}
+
+void task_dacs(float) {
+    instr.writeDacs();
+}
+
+void task_panel(float) {
+    panel.read();
+    panel.update();
+}
+
+void task_leds(float dt) {
+    leds.update(dt);
+    leds.write();
+}
+
+void task_tuning(float) {
+    instr.updateTuning();
+}
+
+void scheduler_setup() {
+    scheduler.addTask("keybed", task_keybed, KEYBED_PERIOD_MICROS, KEYBED_DEADLINE_MICROS);
+    scheduler.addTask("instrument", task_instrument, INSTRUMENT_PERIOD_MICROS);
+    scheduler.addTask("dacs", task_dacs, DACS_PERIOD_MICROS);
+    scheduler.addTask("panel", task_panel, PANEL_PERIOD_MICROS);
+    scheduler.addTask("leds", task_leds, LEDS_PERIOD_MICROS);
+    scheduler.addTask("tuning", task_tuning, TUNING_PERIOD_MICROS);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "StableTimer.h"
+#include "instrument.h"
+#include "led.h"
+#include "panel.h"
+#include "player.h"
+#include "scheduler.h"
+
+// control rates of the individual stages. tasks are not preempted, so every
+// period has to fit the longest run of the others, measured on the bus:
+// dac frame up to 4.4 ms with all channels dirty, panel read 1.7 ms (mux
+// settling), the rest < 0.8 ms
+#define KEYBED_PERIOD_MICROS 1000      // 1 kHz, polls the midi clock follower
+#define KEYBED_DEADLINE_MICROS 5000    // cheap, but may wait for a whole dac frame
+#define INSTRUMENT_PERIOD_MICROS 5000  // 200 Hz
+#define DACS_PERIOD_MICROS 5000        // 200 Hz, a frame goes out whole
+#define PANEL_PERIOD_MICROS 20000      // 50 Hz
+#define LEDS_PERIOD_MICROS 20000       // 50 Hz
+#define TUNING_PERIOD_MICROS 5000      // 200 Hz, idle unless retuning
+
+/**
+ * The control loop of the firmware, shared by main.cpp and the native bench
+ * so both run the same objects, bus settings and task table.
+ */
+extern PanelLedController leds;
+extern Instrument instr;
+extern Player player;
+extern Panel panel;
+extern Scheduler scheduler;
+
+void task_keybed(float dt);
+void task_instrument(float dt);
+void task_dacs(float dt);
+void task_panel(float dt);
+void task_leds(float dt);
+void task_tuning(float dt);
+
+// adds every stage to the scheduler
+void scheduler_setup();
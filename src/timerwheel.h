@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Fixed capacity timer wheel keyed by a microsecond due time. Items are
+ * kept in a node pool and hashed into 2^SlotBits slots of 2^SlotShift us,
+ * each slot a fifo list. schedule() is O(1), popDue() visits the slots the
+ * clock moved over since the last call and fires what is due. Items further
+ * out than one revolution wait in their slot for the right round. Nothing
+ * is allocated after construction, due times may wrap like micros().
+ */
+template <typename T, int Capacity, int SlotBits = 5, int SlotShift = 10>
+class TimerWheel {
+    static constexpr int SLOTS = 1 << SlotBits;
+    static constexpr uint32_t SLOT_MICROS = 1u << SlotShift;
+    static_assert(Capacity < INT16_MAX, "node index is int16_t");
+
+    struct Node {
+        T item;
+        uint32_t due;
+        int16_t next;
+    };
+
+    Node nodes[Capacity];
+    int16_t heads[SLOTS], tails[SLOTS];
+    int16_t freeList;
+    int count = 0;
+    uint32_t cursor = 0;  // start of the slot visited last
+    bool started = false;
+
+    static int slotOf(uint32_t time) {
+        return (time >> SlotShift) & (SLOTS - 1);
+    }
+
+   public:
+    TimerWheel() {
+        clear();
+    }
+
+    void clear() {
+        for (int i = 0; i < SLOTS; i++) {
+            heads[i] = tails[i] = -1;
+        }
+        for (int i = 0; i < Capacity; i++) {
+            nodes[i].next = i + 1 < Capacity ? i + 1 : -1;
+        }
+        freeList = 0;
+        count = 0;
+        started = false;
+    }
+
+    // false if all nodes are in use
+    bool schedule(uint32_t due, const T& item) {
+        if (freeList < 0) {
+            return false;
+        }
+        if (!started) {
+            cursor = due & ~(SLOT_MICROS - 1);
+            started = true;
+        }
+        int16_t n = freeList;
+        freeList = nodes[n].next;
+        nodes[n].item = item;
+        nodes[n].due = due;
+        nodes[n].next = -1;
+
+        // overdue items go to the slot popDue() looks at next
+        int slot = (int32_t)(due - cursor) < 0 ? slotOf(cursor) : slotOf(due);
+        if (tails[slot] < 0) {
+            heads[slot] = n;
+        } else {
+            nodes[tails[slot]].next = n;
+        }
+        tails[slot] = n;
+        count++;
+        return true;
+    }
+
+    // calls fire(item) for every item due at now, returns how many fired
+    template <typename F>
+    int popDue(uint32_t now, F fire) {
+        if (!started) {
+            cursor = now & ~(SLOT_MICROS - 1);
+            started = true;
+        }
+        int fired = 0;
+        for (int visited = 0; count > 0; visited++) {
+            fired += popSlot(slotOf(cursor), now, fire);
+            if ((int32_t)(now - cursor) < (int32_t)SLOT_MICROS || visited >= SLOTS - 1) {
+                break;
+            }
+            cursor += SLOT_MICROS;
+        }
+        // after a full revolution every slot has been checked once
+        if ((int32_t)(now - cursor) >= (int32_t)SLOT_MICROS) {
+            cursor = now & ~(SLOT_MICROS - 1);
+        }
+        return fired;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    bool full() const {
+        return freeList < 0;
+    }
+
+   private:
+    template <typename F>
+    int popSlot(int slot, uint32_t now, F& fire) {
+        int fired = 0;
+        int16_t prev = -1;
+        int16_t n = heads[slot];
+        while (n >= 0) {
+            int16_t next = nodes[n].next;
+            if ((int32_t)(nodes[n].due - now) <= 0) {
+                // unlink and copy before firing, fire may schedule again
+                T item = nodes[n].item;
+                if (prev < 0) {
+                    heads[slot] = next;
+                } else {
+                    nodes[prev].next = next;
+                }
+                if (tails[slot] == n) {
+                    tails[slot] = prev;
+                }
+                nodes[n].next = freeList;
+                freeList = n;
+                count--;
+                fire(item);
+                fired++;
+            } else {
+                prev = n;
+            }
+            n = next;
+        }
+        return fired;
+    }
+};
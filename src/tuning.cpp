@@ -5,6 +5,8 @@
 #include "instrument.h"
 #include "linalg.h"
 #include "memory.h"
+#include "period.h"
+#include "profiler.h"
 #include "utils.h"
 
 #define FREQ_C0 16.35160
@@ -13,131 +15,88 @@ static float idealFrequencyToSemis(float freq) {
     return 12.0 / M_LN2 * logf(freq / FREQ_C0);
 }
 
-volatile static unsigned long microsTuningStart, microsTuningEnd, tuningCycles, totalTuningCycles;
-volatile static bool isTuning;
+#define TUNING_TOLERANCE_CENTS 1.0
+#define TUNING_TIMEOUT_MILLIS 2000
 
-// #define TUNING_CYCLES 100
+static PeriodEstimator loopbackEstimator;
 
-static void measurePitchSubroutine() {
-    if (tuningCycles == 0) {
-        microsTuningStart = micros();
-    }
-    if (tuningCycles >= totalTuningCycles) {
-        microsTuningEnd = micros();
-        detachInterrupt(digitalPinToInterrupt(PIN_AUDIO_LOOPBACK));
-        isTuning = false;
-    }
-    tuningCycles++;
+static void loopbackEdge() {
+    loopbackEstimator.addEdge(profiler_timestamp());
+}
 
-    // debugprintf("tuningCycles %u, isTuning %d\n", tuningCycles);
+static void startLoopbackMeasurement() {
+    loopbackEstimator.begin(TUNING_TOLERANCE_CENTS);
+    attachInterrupt(digitalPinToInterrupt(PIN_AUDIO_LOOPBACK), loopbackEdge, RISING);
 }
 
+static void stopLoopbackMeasurement() {
+    detachInterrupt(digitalPinToInterrupt(PIN_AUDIO_LOOPBACK));
+}
+
+// blocking, only used by testTuning()
 float Instrument::measureFrequency(int voiceIndex, float semis, bool isFilter) {
     if (isFilter) {
-        voices[voiceIndex].out_cutoff = semis;
+        bank.outCutoff[voiceIndex] = semis;
     } else {
-        voices[voiceIndex].out_pitch = semis;
+        bank.outPitch[voiceIndex] = semis;
     }
 
-    float ideal_freq = FREQ_C0 * powf(2, semis / 12.0);
-    float measure_timespan = 1.0;  // seconds
-    totalTuningCycles = max((int)(ideal_freq * measure_timespan), 20);
-
-    // totalTuningCycles = (int)(0.5 * semis + 18.99);
-
     write();
 
     delay(2);  // waiting for voice card to settle on pitch
 
-    tuningCycles = 0;
-    isTuning = true;
+    startLoopbackMeasurement();
+    uint32_t startMillis = millis();
 
-    enterCritical();
-
-    // debugprintf("attached interupt %u\n", digitalPinToInterrupt(PIN_AUDIO_LOOPBACK));
-    attachInterrupt(digitalPinToInterrupt(PIN_AUDIO_LOOPBACK), measurePitchSubroutine, RISING);
-
-    unsigned long maxWaitTime = millis() + 2000;
-    // unsigned long maxWaitTime = millis() + 1000;
-
-    while (isTuning) {
-        delayMicroseconds(500);  // waiting for tuning to finish
-        if (millis() > maxWaitTime) {
-            detachInterrupt(digitalPinToInterrupt(PIN_AUDIO_LOOPBACK));
+    while (!loopbackEstimator.process()) {
+        delayMicroseconds(500);  // waiting for the estimate to converge
+        if (millis() - startMillis > TUNING_TIMEOUT_MILLIS) {
+            stopLoopbackMeasurement();
             debugprintf("[%d] (%s) Tuning timeout, semis=%.2f\n",
                         voiceIndex, isFilter ? "cutoff" : "pitch", semis);
             return -1;
         }
     }
 
-    exitCritical();
-
-    unsigned long elapsedMicros = microsTuningEnd - microsTuningStart;
-    float freq = totalTuningCycles / (elapsedMicros / 1000000.0);
-    return freq;
+    stopLoopbackMeasurement();
+    return loopbackEstimator.getEstimate().frequency;
 }
 
-#define TUNING_SAMPLES 10
-
-int Instrument::findTuningProfile(int voiceIndex, float semis_min, float semis_max, bool isFilter) {
-    TuningCorrection* corr;
-    if (isFilter) {
-        corr = &voices[voiceIndex].cutoff_correction;
-    } else {
-        corr = &voices[voiceIndex].pitch_correction;
+static void load_correction(TuningCorrection& corr, const float* parabolic, const TuningSpline* spline) {
+    for (int i = 0; i < 3; i++) {
+        corr.parabolic[i] = parabolic[i];
     }
-    // reset
-    corr->parabolic[0] = 0;
-    corr->parabolic[1] = 1;
-    corr->parabolic[2] = 0;
-
-    float x[TUNING_SAMPLES] = {0};
-    float y[TUNING_SAMPLES] = {0};
-    int successful_samples = 0;
-
-    float step = (semis_max - semis_min) / (TUNING_SAMPLES - 1);
-
-    // debugprintf("\n\nvoice, type, test_semis, test_freq, actual_semis\n");
-
-    for (int i = 0; i < TUNING_SAMPLES; i++) {
-        float test_semis = semis_min + i * step;
-        float test_freq = measureFrequency(voiceIndex, test_semis, isFilter);
-        if (test_freq < 0.0) {
-            continue;  // timeout
-        }
-        float ideal_semis = idealFrequencyToSemis(test_freq);
-        x[i] = ideal_semis;
-        y[i] = test_semis;
-        successful_samples++;
-
-        debugprintf("%d, %s, %e, %e, %e\n",
-                    voiceIndex, isFilter ? "cutoff" : "pitch", test_semis, test_freq, ideal_semis);
+    if (spline) {
+        corr.spline = *spline;
+    } else {
+        spline_reset(corr.spline);
     }
+}
 
-    if (successful_samples < 5) {
-        debugprintf("[%d] (%s) too little samples!\n", voiceIndex, isFilter ? "cutoff" : "pitch");
-        return 1;
+static void save_correction(const TuningCorrection& corr, float* parabolic, TuningSpline& spline) {
+    for (int i = 0; i < 3; i++) {
+        parabolic[i] = corr.parabolic[i];
     }
-
-    // solve LSQ
-    fit_parabola(x, y, TUNING_SAMPLES, corr->parabolic);
-
-    // debugprintf("%-6d%-7s a+bx+cx^2: %-14e%-14e%-14e\n",
-    //             voiceIndex, isFilter ? "cutoff" : "pitch", corr->parabolic[0], corr->parabolic[1], corr->parabolic[2]);
-
-    return 0;
+    spline = corr.spline;
 }
 
 void Instrument::load_tuning() {
     MemoryBlockTuning tuningMemory;
+    MemoryBlockSplines splineMemory;
     // TuningCorrection corrections[2 * ACTIVE_VOICES];
 
     memory_load_buffer((uint8_t*)&tuningMemory, MEMORY_TUNING_START_ADDRESS, sizeof(MemoryBlockTuning));
+    memory_load_buffer((uint8_t*)&splineMemory, MEMORY_SPLINES_START_ADDRESS, sizeof(MemoryBlockSplines));
+    // older tunings only have the parabola
+    bool hasSplines = splineMemory.magic == MEMORY_SPLINES_MAGIC && splineMemory.knots == SPLINE_KNOTS;
 
     for (int i = 0; i < ACTIVE_VOICES; i++) {
         Voice& voice = voices[i];
-        voice.pitch_correction = tuningMemory.corrections[i][0];
-        voice.cutoff_correction = tuningMemory.corrections[i][1];
+        load_correction(voice.pitch_correction, tuningMemory.corrections[i][0],
+                        hasSplines ? &splineMemory.splines[i][0] : nullptr);
+        load_correction(voice.cutoff_correction, tuningMemory.corrections[i][1],
+                        hasSplines ? &splineMemory.splines[i][1] : nullptr);
+        voice.compileCorrections();
     }
 
     modCenter = tuningMemory.modCenter;
@@ -145,55 +104,362 @@ void Instrument::load_tuning() {
     // printf("modCenter=%f, pitchBendCenter=%f\n", modCenter, pitchBendCenter);
 }
 
-void Instrument::tune() {
-    MemoryBlockTuning tuningMemory;
-    // TuningCorrection newCorrections[2 * ACTIVE_VOICES];
-
-    mainVolume = 0;
+#define TUNING_PITCH_MIN 15
+#define TUNING_PITCH_MAX 105
+#define TUNING_CUTOFF_MIN 20
+#define TUNING_CUTOFF_MAX 65
+#define TUNING_MIN_SAMPLES 5
+#define TUNING_SETTLE_MILLIS 2  // voice card settling once the dacs hold the sample
+#define TUNING_MEASURE_MILLIS 1000  // after this an unconverged estimate is used as is
+#define TUNING_SILENT_AMP 0.01
+
+// all voices silent for this long before an idle voice is checked
+#define DRIFT_IDLE_MILLIS 2000
+// minimum time between checks of the same voice
+#define DRIFT_INTERVAL_MILLIS 60000
+// larger errors are assumed to be bad measurements and only partly corrected
+#define DRIFT_MAX_STEP_SEMIS 0.25
+// time constant of the warm-up drift
+#define DRIFT_WARMUP_SECONDS 1200.0
+#define DRIFT_RATE_SMOOTHING 0.5
+// one voice is extrapolated per interval, tables are only recompiled on a change
+#define DRIFT_PREDICT_MILLIS 1000
+#define DRIFT_RECOMPILE_SEMIS 0.003
+#define DRIFT_POINTS 2
+
+// pitches checked by the drift tracker, in the middle of the playing range
+static const float driftPoints[DRIFT_POINTS] = {45, 69};
 
+void Instrument::tune() {
+    if (isTuningActive()) {
+        return;
+    }
+    abortDriftMeasurement();
     debugprintf("Tuning:\n");
 
     leds.setAllNumbers(LedModes::LED_MODE_OFF);
-    leds.write();
 
+    tuningJob = TuningJob();
+    tuningJob.voice = 0;
+    setTuningStep(TUNING_WAIT_RELEASE);
+}
+
+bool Instrument::isTuningActive() {
+    return tuningJob.step != TUNING_IDLE && !tuningJob.isDrift;
+}
+
+bool Instrument::isVoiceReserved(int voiceIndex) {
+    return isTuningActive() && tuningJob.voice == voiceIndex;
+}
+
+bool Instrument::otherVoicesSilent(int voiceIndex) {
     for (int i = 0; i < ACTIVE_VOICES; i++) {
-        // mute all voices
+        if (i != voiceIndex && (voices[i].gate || bank.outAmp[i] > TUNING_SILENT_AMP)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        for (int j = 0; j < VOICE_COUNT; j++) {
-            voices[j].out_amp = 0.0;
+float Instrument::tuningSampleSemis() {
+    if (tuningJob.isDrift) {
+        return driftPoints[tuningJob.sample];
+    }
+    float lo = tuningJob.isFilter ? TUNING_CUTOFF_MIN : TUNING_PITCH_MIN;
+    float hi = tuningJob.isFilter ? TUNING_CUTOFF_MAX : TUNING_PITCH_MAX;
+    return lo + tuningJob.sample * (hi - lo) / (TUNING_SAMPLES - 1);
+}
+
+void Instrument::setTuningStep(TuningStep step) {
+    tuningJob.step = step;
+    tuningJob.stepStartMillis = millis();
+    // the next published frame applies the outputs of this step
+    tuningJob.settleFrame = frames.getSequence() + 1;
+}
+
+// a played note ends the sounding steps, the sample is repeated once the voices are silent again
+void Instrument::yieldTuningToPlaying() {
+    TuningJob& job = tuningJob;
+    bool sounding = job.step == TUNING_SETTLE || job.step == TUNING_MEASURE;
+    if (!sounding || otherVoicesSilent(job.voice)) {
+        return;
+    }
+    if (job.isDrift) {
+        abortDriftMeasurement();
+        return;
+    }
+    if (job.step == TUNING_MEASURE) {
+        stopLoopbackMeasurement();
+    }
+    setTuningStep(TUNING_WAIT_SILENCE);
+}
+
+// overrides the computed outputs of the reserved voice, called at the end of update()
+void Instrument::applyTuningOutputs() {
+    // before muting, so the first frame of a new note is not muted
+    yieldTuningToPlaying();
+    if (tuningJob.step == TUNING_IDLE || tuningJob.step == TUNING_WAIT_RELEASE) {
+        return;
+    }
+    int i = tuningJob.voice;
+    float semis = tuningSampleSemis();
+
+    if (tuningJob.isFilter) {
+        // self oscillating filter
+        bank.outCutoff[i] = semis;
+        bank.outResonance[i] = 0.6;
+    } else {
+        bank.outPitch[i] = semis;
+        bank.outCutoff[i] = 120;
+        bank.outResonance[i] = 0;
+    }
+    bank.outPulse[i] = 0.5;
+    bank.outSub[i] = 0;
+
+    bool sounding = tuningJob.step == TUNING_SETTLE || tuningJob.step == TUNING_MEASURE;
+    bank.outAmp[i] = sounding ? 1 : 0;
+    if (sounding) {
+        // other voices are silent, output stays muted while the loopback is measured
+        mixer = tuningJob.isFilter ? 0 : MIXER_SQR;
+        mainVolume = 0;
+    }
+}
+
+void Instrument::updateTuning() {
+    yieldTuningToPlaying();
+    TuningJob& job = tuningJob;
+    uint32_t stepMillis = millis() - job.stepStartMillis;
+
+    switch (job.step) {
+        case TUNING_IDLE:
+            trackDrift();
+            return;
+
+        case TUNING_WAIT_RELEASE:
+            if (!voices[job.voice].gate) {
+                job.previousCorrection = voices[job.voice].pitch_correction;
+                reset_correction(voices[job.voice].pitch_correction);
+                voices[job.voice].compileCorrections();
+                setTuningStep(TUNING_WAIT_SILENCE);
+            }
+            break;
+
+        case TUNING_WAIT_SILENCE:
+            if (otherVoicesSilent(job.voice)) {
+                setTuningStep(TUNING_SETTLE);
+            }
+            break;
+
+        case TUNING_SETTLE:
+            // settling starts once the sample is on the dacs, however long the frame took
+            if ((int32_t)(dacs_sent_sequence() - job.settleFrame) < 0) {
+                job.stepStartMillis = millis();
+            } else if (stepMillis >= TUNING_SETTLE_MILLIS) {
+                startLoopbackMeasurement();
+                setTuningStep(TUNING_MEASURE);
+            }
+            break;
+
+        case TUNING_MEASURE: {
+            bool converged = loopbackEstimator.process();
+            PeriodEstimate estimate = loopbackEstimator.getEstimate();
+            bool longEnough = stepMillis > TUNING_MEASURE_MILLIS && estimate.edges >= PERIOD_MIN_EDGES;
+
+            if (job.isDrift && (converged || longEnough)) {
+                stopLoopbackMeasurement();
+                job.driftError += idealFrequencyToSemis(estimate.frequency) - tuningSampleSemis();
+                nextDriftPoint();
+            } else if (converged || longEnough) {
+                stopLoopbackMeasurement();
+                float freq = estimate.frequency;
+                job.x[job.successfulSamples] = idealFrequencyToSemis(freq);
+                job.y[job.successfulSamples] = tuningSampleSemis();
+                job.successfulSamples++;
+
+                debugprintf("%d, %s, %e, %e, %e, %.3f, %d, %d, %lu\n",
+                            job.voice, job.isFilter ? "cutoff" : "pitch", tuningSampleSemis(), freq, idealFrequencyToSemis(freq),
+                            estimate.cents, estimate.edges, estimate.rejected, stepMillis);
+                nextTuningSample();
+            } else if (job.isDrift && stepMillis > TUNING_TIMEOUT_MILLIS) {
+                // voice stays unmeasured until the next interval
+                voices[job.voice].drift.measuredMillis = millis();
+                abortDriftMeasurement();
+            } else if (stepMillis > TUNING_TIMEOUT_MILLIS) {
+                stopLoopbackMeasurement();
+                debugprintf("[%d] (%s) Tuning timeout, semis=%.2f\n",
+                            job.voice, job.isFilter ? "cutoff" : "pitch", tuningSampleSemis());
+                nextTuningSample();
+            }
+            break;
         }
-        Voice& voice = voices[i];
+    }
+}
 
-        reset_correction(voice.pitch_correction);
-        reset_correction(voice.cutoff_correction);
+void Instrument::nextTuningSample() {
+    TuningJob& job = tuningJob;
+    job.sample++;
+    if (job.sample < TUNING_SAMPLES) {
+        setTuningStep(TUNING_WAIT_SILENCE);
+        return;
+    }
+    finishTuningProfile();
+
+    job.sample = 0;
+    job.successfulSamples = 0;
+    if (!job.isFilter) {
+        // same voice, filter resonance tracking
+        job.isFilter = true;
+        job.previousCorrection = voices[job.voice].cutoff_correction;
+        reset_correction(voices[job.voice].cutoff_correction);
+        voices[job.voice].compileCorrections();
+        setTuningStep(TUNING_WAIT_SILENCE);
+        return;
+    }
 
-        // OSCILLATOR PITCH
-        mixer = MIXER_SQR;
-        voice.out_cutoff = 120;
-        voice.out_pulse = 0.5;
-        voice.out_resonance = 0;
-        voice.out_sub = 0;
-        voice.out_amp = 1;
-        int errored = findTuningProfile(i, 15, 105, false);  // dac write is called later on
-
-        leds.setSingle(
-            (PanelLeds)(PanelLeds::LED_PATCH_01 + 2 * i),
-            errored ? LedModes::LED_MODE_OFF : LedModes::LED_MODE_ON);
-        leds.write();
-
-        // FILTER RESONANCE TRACKING
-        mixer = 0;
-        voice.out_resonance = 0.6;
-        voice.out_amp = 1;
-        errored = findTuningProfile(i, 20, 65, true);  // dac write is called later on
+    job.isFilter = false;
+    job.voice++;
+    if (job.voice >= ACTIVE_VOICES) {
+        finishTuning();
+        return;
+    }
+    setTuningStep(TUNING_WAIT_RELEASE);
+}
 
-        leds.setSingle(
-            (PanelLeds)(PanelLeds::LED_PATCH_01 + 2 * i + 1),
-            errored ? LedModes::LED_MODE_OFF : LedModes::LED_MODE_ON);
-        leds.write();
+void Instrument::finishTuningProfile() {
+    TuningJob& job = tuningJob;
+    Voice& voice = voices[job.voice];
+    TuningCorrection& corr = job.isFilter ? voice.cutoff_correction : voice.pitch_correction;
 
-        tuningMemory.corrections[i][0] = voice.pitch_correction;
-        tuningMemory.corrections[i][1] = voice.cutoff_correction;
+    bool errored = job.successfulSamples < TUNING_MIN_SAMPLES;
+    if (errored) {
+        debugprintf("[%d] (%s) too little samples!\n", job.voice, job.isFilter ? "cutoff" : "pitch");
+        corr = job.previousCorrection;
+    } else {
+        // solve LSQ over the samples which did not time out,
+        // the parabola stays as fallback for firmware without splines
+        fit_parabola(job.x, job.y, job.successfulSamples, corr.parabolic);
+        if (!spline_fit(job.x, job.y, job.successfulSamples, corr.spline)) {
+            spline_reset(corr.spline);
+        }
+        if (!job.isFilter) {
+            // drift is tracked relative to the fresh fit
+            voice.drift = DriftModel();
+            voice.drift.measured = true;
+            voice.drift.measuredMillis = millis();
+        }
+    }
+    voice.compileCorrections();
+
+    leds.setSingle(
+        (PanelLeds)(PanelLeds::LED_PATCH_01 + 2 * job.voice + job.isFilter),
+        errored ? LedModes::LED_MODE_OFF : LedModes::LED_MODE_ON);
+}
+
+// advanced while no calibration runs, measures the voice checked longest ago
+// once everything has been silent for a while
+void Instrument::trackDrift() {
+    uint32_t now = millis();
+    if (!otherVoicesSilent(-1)) {
+        silentSinceMillis = now;
+    }
+    if (now - driftPredictMillis >= DRIFT_PREDICT_MILLIS) {
+        driftPredictMillis = now;
+        predictDrift();
+    }
+    if (now - silentSinceMillis < DRIFT_IDLE_MILLIS) {
+        return;
+    }
+
+    int voice = -1;
+    uint32_t longest = 0;
+    for (int i = 0; i < ACTIVE_VOICES; i++) {
+        uint32_t since = now - voices[i].drift.measuredMillis;
+        bool due = !voices[i].drift.measured || since >= DRIFT_INTERVAL_MILLIS;
+        if (due && (voice < 0 || since > longest)) {
+            voice = i;
+            longest = since;
+        }
+    }
+    if (voice < 0) {
+        return;
+    }
+    tuningJob = TuningJob();
+    tuningJob.isDrift = true;
+    tuningJob.voice = voice;
+    setTuningStep(TUNING_SETTLE);
+}
+
+// extrapolates the warm-up curve of one voice, which approaches its final
+// offset exponentially
+void Instrument::predictDrift() {
+    int i = driftPredictVoice;
+    driftPredictVoice = (driftPredictVoice + 1) % ACTIVE_VOICES;
+
+    Voice& voice = voices[i];
+    const DriftModel& model = voice.drift;
+    if (!model.measured || model.rate == 0) {
+        return;
+    }
+    float seconds = (millis() - model.measuredMillis) / 1000.0f;
+    float predicted = model.offset + model.rate * DRIFT_WARMUP_SECONDS * (1 - expf(-seconds / DRIFT_WARMUP_SECONDS));
+    if (fabsf(predicted - voice.pitch_correction.offset) >= DRIFT_RECOMPILE_SEMIS) {
+        voice.pitch_correction.offset = predicted;
+        dacs_compile_correction(voice.pitch_correction, voice.pitch_codes);
+    }
+}
+
+void Instrument::nextDriftPoint() {
+    TuningJob& job = tuningJob;
+    job.sample++;
+    if (job.sample < DRIFT_POINTS) {
+        setTuningStep(TUNING_SETTLE);
+        return;
+    }
+
+    Voice& voice = voices[job.voice];
+    DriftModel& model = voice.drift;
+    uint32_t now = millis();
+
+    // pitch profiles have a slope close to one, so the pitch error can be
+    // subtracted from the offset directly
+    float error = job.driftError / DRIFT_POINTS;
+    float step = fminf(fmaxf(-error, -DRIFT_MAX_STEP_SEMIS), DRIFT_MAX_STEP_SEMIS);
+    float offset = voice.pitch_correction.offset + step;
+
+    if (model.measured && now != model.measuredMillis) {
+        float observed = (offset - model.offset) / ((now - model.measuredMillis) / 1000.0f);
+        model.rate = DRIFT_RATE_SMOOTHING * observed + (1 - DRIFT_RATE_SMOOTHING) * model.rate;
+    }
+    model.measured = true;
+    model.offset = offset;
+    model.measuredMillis = now;
+
+    voice.pitch_correction.offset = offset;
+    dacs_compile_correction(voice.pitch_correction, voice.pitch_codes);
+    debugprintf("[%d] drift %.2f cents, offset %.2f cents, %.3f cents/min\n",
+                job.voice, 100 * error, 100 * offset, 6000 * model.rate);
+
+    tuningJob = TuningJob();
+}
+
+// drift checks give way to playing, the voice is rechecked at the next pause
+void Instrument::abortDriftMeasurement() {
+    if (tuningJob.step == TUNING_IDLE || !tuningJob.isDrift) {
+        return;
+    }
+    stopLoopbackMeasurement();
+    tuningJob = TuningJob();
+}
+
+void Instrument::finishTuning() {
+    MemoryBlockTuning tuningMemory;
+    MemoryBlockSplines splineMemory = {};
+    splineMemory.magic = MEMORY_SPLINES_MAGIC;
+    splineMemory.knots = SPLINE_KNOTS;
+
+    for (int i = 0; i < ACTIVE_VOICES; i++) {
+        save_correction(voices[i].pitch_correction, tuningMemory.corrections[i][0], splineMemory.splines[i][0]);
+        save_correction(voices[i].cutoff_correction, tuningMemory.corrections[i][1], splineMemory.splines[i][1]);
     }
 
     int numSamples = 4;
@@ -225,11 +491,14 @@ void Instrument::tune() {
 
     // save tuning
     memory_save_buffer((uint8_t*)&tuningMemory, MEMORY_TUNING_START_ADDRESS, sizeof(MemoryBlockTuning));
+    memory_save_buffer((uint8_t*)&splineMemory, MEMORY_SPLINES_START_ADDRESS, sizeof(MemoryBlockSplines));
+
+    tuningJob.step = TUNING_IDLE;
+    debugprintf("Tuning done\n");
 }
 
 void Instrument::testTuning() {
     mainVolume = 0;
-    totalTuningCycles = 100;
 
     for (int j = 5; j < 150; j += 5) {
         debugprintf("%-10d", j);
@@ -240,26 +509,27 @@ void Instrument::testTuning() {
         // mute all voices
 
         for (int j = 0; j < VOICE_COUNT; j++) {
-            voices[j].out_amp = 0.0;
+            bank.outAmp[j] = 0.0;
         }
         Voice& voice = voices[i];
 
         // OSCILLATOR PITCH
         mixer = MIXER_SQR;
-        voice.out_cutoff = 120;
-        voice.out_pulse = 0.5;
-        voice.out_resonance = 0;
-        voice.out_sub = 0;
-        voice.out_amp = 1;
+        bank.outCutoff[i] = 120;
+        bank.outPulse[i] = 0.5;
+        bank.outResonance[i] = 0;
+        bank.outSub[i] = 0;
+        bank.outAmp[i] = 1;
 
         mixer = 0;
-        voice.out_resonance = 0.6;
-        voice.out_amp = 1;
+        bank.outResonance[i] = 0.6;
+        bank.outAmp[i] = 1;
 
         for (int j = 5; j < 150; j += 5) {
             // reset
             reset_correction(voice.pitch_correction);
             reset_correction(voice.cutoff_correction);
+            voice.compileCorrections();
 
             float freq = measureFrequency(i, (float)j, true);
             debugprintf("%-10.1f", freq);
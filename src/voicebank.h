@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+
+#include "sine.h"
+
+#define ADSR_EPS 0.05
+#define ADSR_MINUS_LN_EPS 2.9957
+
+enum EnvelopeState {
+    ENVELOPE_ATTACK,
+    ENVELOPE_DECAY,
+    ENVELOPE_RELEASE,
+};
+
+// patch faders and instrument settings converted to seconds, Hz and semitones
+struct PatchParams {
+    float attack, decay, sustain, release;
+    float lfoFrequency, lfoDelay;
+    float vibrato, modVibrato;
+    float cutoff, cutoffKeytrack, cutoffLfo, cutoffEnvelope, modTremolo;
+    float pitchBendRange;
+    float pulseWidth, sub, resonance;
+    int8_t lfoSync, pwmSource, ampShape;
+};
+
+static inline float voicebank_clamp01(float x) {
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+/**
+ * Every lfo of the instrument, stored as one array per field and advanced
+ * in a single pass. Gates restart the delayed fade in on their rising edge.
+ */
+template <int N>
+struct LfoBank {
+    // inputs
+    float frequency[N] = {};
+    float drift[N] = {};
+    float delay[N] = {};
+    uint8_t gate[N] = {};
+
+    uint8_t lastGate[N] = {};
+    float time[N] = {};
+    uint32_t phase[N] = {};  // full period is 2^32
+    float level[N] = {};
+
+    void update(float dt) {
+        for (int i = 0; i < N; i++) {
+            uint8_t rising = gate[i] & !lastGate[i];
+            time[i] = rising ? 0.0f : time[i];
+            lastGate[i] = gate[i];
+
+            // linear fade in after the delay, integer phase wraps exactly
+            float amplitude = voicebank_clamp01((time[i] - delay[i]) * 50);
+            phase[i] += phaseIncrement(frequency[i] + drift[i], dt);
+            level[i] = amplitude * sinePhase(phase[i]);
+
+            // time only matters until the fade in is done
+            time[i] += time[i] < delay[i] + 1 ? dt : 0.0f;
+        }
+    }
+};
+
+/**
+ * Per voice state which changes every control frame, stored as one array
+ * per field. Each stage of update() is a flat loop over all voices without
+ * data dependent branches, so the compiler is free to vectorize it. N can
+ * be raised for expander boards without touching the scheduling code.
+ */
+template <int N>
+struct VoiceBank {
+    // inputs, copied from the voice allocator
+    float note[N] = {};
+    uint8_t gate[N] = {};
+
+    uint8_t lastGate[N] = {};
+    uint8_t envState[N] = {};  // EnvelopeState, a byte per voice
+    float envLevel[N] = {};
+
+    // final values, uncorrected
+    float outPitch[N] = {};
+    float outCutoff[N] = {};
+    float outPulse[N] = {};
+    float outSub[N] = {};
+    float outResonance[N] = {};
+    float outAmp[N] = {};
+
+    VoiceBank() {
+        for (int i = 0; i < N; i++) {
+            envState[i] = ENVELOPE_RELEASE;
+        }
+    }
+
+    // lfoLevel holds the voice lfos, advanced beforehand in the lfo bank
+    void update(float dt, const PatchParams& params, const float* lfoLevel, float syncedLfoLevel, float pitchBend, float modWheel) {
+        // gate edges restart the envelope
+        for (int i = 0; i < N; i++) {
+            uint8_t changed = gate[i] != lastGate[i];
+            uint8_t restarted = gate[i] ? (uint8_t)ENVELOPE_ATTACK : (uint8_t)ENVELOPE_RELEASE;
+            envState[i] = changed ? restarted : envState[i];
+            lastGate[i] = gate[i];
+        }
+
+        // envelope, exponential approach of the target of each stage
+        float attackCoeff = voicebank_clamp01(ADSR_MINUS_LN_EPS / params.attack * dt);
+        float decayCoeff = voicebank_clamp01(ADSR_MINUS_LN_EPS / params.decay * dt);
+        float releaseCoeff = voicebank_clamp01(ADSR_MINUS_LN_EPS / params.release * dt);
+        for (int i = 0; i < N; i++) {
+            uint8_t state = envState[i];
+            float target = state == ENVELOPE_ATTACK ? 1.0f : (state == ENVELOPE_DECAY ? params.sustain : 0.0f);
+            float coeff = state == ENVELOPE_ATTACK ? attackCoeff : (state == ENVELOPE_DECAY ? decayCoeff : releaseCoeff);
+            float delta = target - envLevel[i];
+            envLevel[i] += delta * coeff;
+            bool attackDone = state == ENVELOPE_ATTACK && fabsf(delta) < ADSR_EPS;
+            envState[i] = attackDone ? (uint8_t)ENVELOPE_DECAY : state;
+        }
+
+        // outputs
+        float vibrato = params.vibrato + params.modVibrato * modWheel;
+        float tremolo = params.cutoffLfo + params.modTremolo * modWheel;
+        float pitchBendPitch = pitchBend * params.pitchBendRange;
+        float pwm = params.pulseWidth;
+        for (int i = 0; i < N; i++) {
+            float lfoVoltage = params.lfoSync ? syncedLfoLevel : lfoLevel[i];
+            outPitch[i] = note[i] + vibrato * lfoVoltage + pitchBendPitch;
+            outCutoff[i] = params.cutoff + params.cutoffKeytrack * note[i] + tremolo * lfoVoltage + params.cutoffEnvelope * envLevel[i];
+            outPulse[i] = params.pwmSource == 0   ? 0.5f + 0.5f * envLevel[i] * pwm
+                          : params.pwmSource == 1 ? 0.5f + 0.5f * lfoVoltage * pwm
+                                                  : pwm;
+            outSub[i] = params.sub;
+            outResonance[i] = params.resonance;
+            outAmp[i] = params.ampShape == 0   ? 0.4f * envLevel[i]
+                        : params.ampShape == 1 ? (gate[i] ? 0.4f : 0.0f)
+                                               : 0.0f;
+        }
+    }
+};
@@ -0,0 +1,157 @@
+"""
+Decodes an spi trace of SPIWrapper::printTrace() back into device state and
+prints the bus occupancy per device.
+
+    python test/decode_spi_trace.py trace.csv [--timeline] [--diff other.csv]
+
+A trace comes from serial command 't' or from the native bench, which writes
+it as its second argument. Every decoded value change is an event, dac
+values are decoded once per frame of dacs_write(), so a 16 bit code split
+over two channels is never seen half written.
+
+--timeline  prints the events with their timestamps
+--diff      aligns the events of both traces and prints where they differ
+"""
+
+import argparse
+import csv
+import difflib
+
+# same layout as src/dacs.cpp
+DAC_COUNT = 8
+LOWER_CHANNELS = ["pulse a", "pulse b", "resonance b", "amp b", "resonance a", "amp a", "sub b", "sub a"]
+UPPER_CODES = {"cutoff b": 0, "pitch b": 2, "cutoff a": 4, "pitch a": 6}  # high byte channel, low byte follows
+
+
+def load(path):
+    with open(path) as f:
+        return [(int(r["micros"]), r["device"], r["event"], int(r["word"])) for r in csv.DictReader(f)]
+
+
+def transactions(trace):
+    """(start, end, device, words) of every complete select to deselect"""
+    open_ = None
+    for micros, device, event, word in trace:
+        if event == "select":
+            open_ = (micros, device, [])
+        elif open_ is None or device != open_[1]:
+            continue  # started before the ring
+        elif event == "word":
+            open_[2].append(word)
+        else:
+            yield open_[0], micros, device, open_[2]
+            open_ = None
+
+
+def dac_voice_values(levels):
+    """values of the voices whose channels were all sent since the trace started"""
+    values = {}
+    for dac in range(0, DAC_COUNT, 2):
+        lower, upper = levels[dac], levels[dac + 1]
+        voice = {"a": dac, "b": dac + 1}
+        for channel, name in enumerate(LOWER_CHANNELS):
+            field, side = name.split()
+            if lower[channel] is not None:
+                values[f"voice {voice[side]} {field}"] = lower[channel]
+        for name, channel in UPPER_CODES.items():
+            field, side = name.split()
+            if upper[channel] is not None and upper[channel + 1] is not None:
+                values[f"voice {voice[side]} {field}"] = (upper[channel] << 8) | upper[channel + 1]
+    return values
+
+
+def decode(trace):
+    """value changes as (micros, device, field, value)"""
+    events = []
+    state = {}
+    levels = [[None] * 8 for _ in range(DAC_COUNT)]
+    last_channel = None
+    frame_end = None
+
+    def change(micros, device, field, value):
+        if state.get((device, field)) != value:
+            state[(device, field)] = value
+            events.append((micros, device, field, value))
+
+    def flush_dac_frame():
+        if frame_end is not None:
+            for field, value in dac_voice_values(levels).items():
+                change(frame_end, "dac", field, value)
+
+    for start, end, device, words in transactions(trace):
+        if device == "dac":
+            channel = (words[0] >> 12) - 1 if words else 0
+            # channels go up within a frame, channels without changes are skipped
+            if last_channel is not None and channel <= last_channel:
+                flush_dac_frame()
+            for k, word in enumerate(words):
+                levels[DAC_COUNT - 1 - k][(word >> 12) - 1] = (word >> 4) & 0xFF
+            last_channel, frame_end = channel, end
+        elif device == "chorus":
+            for word in words:
+                change(end, device, "level b" if word & 0x8000 else "level a", (word >> 4) & 0xFF)
+        elif device == "amp":
+            for word in words:
+                change(end, device, "gain", ((word >> 8) & 0xFF, word & 0xFF))
+        elif device == "leds" and len(words) == 2:
+            change(end, device, "shift registers", f"{(words[0] << 16) | words[1]:08x}")
+        elif device == "keybed":
+            for word in words:
+                low = word & 0xFF
+                change(end, device, "row", (low & -low).bit_length() - 1)
+    flush_dac_frame()
+    # dac frames are decoded when the next one starts
+    events.sort(key=lambda e: e[0])
+    return events
+
+
+def occupancy(trace):
+    span = trace[-1][0] - trace[0][0] if trace else 0
+    busy, frames, words = {}, {}, {}
+    for start, end, device, w in transactions(trace):
+        busy[device] = busy.get(device, 0) + end - start
+        frames[device] = frames.get(device, 0) + 1
+        words[device] = words.get(device, 0) + len(w)
+    print(f"{'device':10}{'frames':>8}{'words':>8}{'busy us':>10}{'busy %':>8}{'us/frame':>10}")
+    for device in sorted(busy, key=busy.get, reverse=True):
+        share = 100 * busy[device] / span if span else 0
+        print(f"{device:10}{frames[device]:8}{words[device]:8}{busy[device]:10}{share:8.1f}{busy[device] / frames[device]:10.1f}")
+    total = sum(busy.values())
+    print(f"{'all':10}{sum(frames.values()):8}{sum(words.values()):8}{total:10}{100 * total / span if span else 0:8.1f}")
+    print(f"trace spans {span} us")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("trace")
+    parser.add_argument("--timeline", action="store_true")
+    parser.add_argument("--diff")
+    args = parser.parse_args()
+
+    trace = load(args.trace)
+    occupancy(trace)
+    events = decode(trace)
+
+    if args.timeline:
+        print()
+        for micros, device, field, value in events:
+            print(f"{micros:12} {device:8} {field:20} {value}")
+
+    if args.diff:
+        other = decode(load(args.diff))
+        a = [e[1:] for e in events]
+        b = [e[1:] for e in other]
+        matcher = difflib.SequenceMatcher(a=a, b=b, autojunk=False)
+        print(f"\n{len(a)} and {len(b)} events, {100 * matcher.ratio():.1f} % alike")
+        for tag, i1, i2, j1, j2 in matcher.get_opcodes():
+            if tag == "equal":
+                continue
+            at = events[i1][0] if i1 < len(events) else "end"
+            print(f"{tag} at {at}:")
+            for e in events[i1:i2]:
+                print(f"  - {e[1]} {e[2]} {e[3]}")
+            for e in other[j1:j2]:
+                print(f"  + {e[1]} {e[2]} {e[3]}")
+
+
+main()
@@ -0,0 +1,160 @@
+"""
+Replays recorded tuning runs through the parabola fit and the spline fit of
+src/spline.cpp and prints the residual pitch error in cents.
+
+    python test/evaluate_spline.py
+
+in sample:  fitted and evaluated on all samples of a profile
+held out:   fitted on every other sample, evaluated on the rest
+cross run:  fitted on the 10 sample run, evaluated on the 50 sample run
+"""
+
+import csv
+import math
+
+runs = [
+    "test/50_tuning_samples_100ms_timespan.csv",
+    "test/10_tuning_samples_1000ms_timespan.csv",
+]
+
+# same constants as src/spline.h
+SPLINE_KNOTS = 12
+SPLINE_SCALE = 256.0
+SPLINE_SMOOTHING = 0.5
+
+
+def solve(A, b):
+    n = len(b)
+    for i in range(n):
+        diag = A[i][i]
+        for j in range(i, n):
+            A[i][j] /= diag
+        b[i] /= diag
+        for k in range(i + 1, n):
+            factor = A[k][i]
+            for j in range(i, n):
+                A[k][j] -= factor * A[i][j]
+            b[k] -= factor * b[i]
+    x = [0.0] * n
+    for i in reversed(range(n)):
+        x[i] = b[i] - sum(A[i][j] * x[j] for j in range(i + 1, n))
+    return x
+
+
+def fit_parabola(x, y):
+    S = [sum(xi**k for xi in x) for k in range(5)]
+    T = [sum(yi * xi**k for xi, yi in zip(x, y)) for k in range(3)]
+    A = [[S[0], S[1], S[2]], [S[1], S[2], S[3]], [S[2], S[3], S[4]]]
+    a, b, c = solve(A, T)
+    return lambda t: a + t * (b + t * c)
+
+
+def fit_spline(x, y):
+    n = SPLINE_KNOTS
+    lo, hi = min(x), max(x)
+    spacing = round((hi - lo) / (n - 1) * SPLINE_SCALE) / SPLINE_SCALE
+    start = round(lo * SPLINE_SCALE) / SPLINE_SCALE
+
+    # linear spline least squares on the offsets, second differences penalized
+    A = [[0.0] * n for _ in range(n)]
+    b = [0.0] * n
+    for xi, yi in zip(x, y):
+        position = min(max((xi - start) / spacing, 0), n - 1)
+        k = min(int(position), n - 2)
+        t = position - k
+        w = {k: 1 - t, k + 1: t}
+        for i, wi in w.items():
+            b[i] += wi * (yi - xi)
+            for j, wj in w.items():
+                A[i][j] += wi * wj
+    smoothing = SPLINE_SMOOTHING * len(x) / n
+    for k in range(n - 2):
+        d = {k: 1.0, k + 1: -2.0, k + 2: 1.0}
+        for i, di in d.items():
+            for j, dj in d.items():
+                A[i][j] += smoothing * di * dj
+    offsets = solve(A, b)
+
+    values = []
+    for k in range(n):
+        value = start + k * spacing + round(offsets[k] * SPLINE_SCALE) / SPLINE_SCALE
+        if values and value < values[-1]:
+            value = values[-1]  # keep it monotone
+        values.append(value)
+
+    secants = [(values[k + 1] - values[k]) / spacing for k in range(n - 1)]
+    tangents = [secants[0]]
+    for k in range(1, n - 1):
+        a, c = secants[k - 1], secants[k]
+        tangents.append(0.0 if a * c <= 0 else 2 / (1 / a + 1 / c))
+    tangents.append(secants[-1])
+
+    def evaluate(t):
+        position = (t - start) / spacing
+        if position <= 0:
+            return values[0] + (t - start) * tangents[0]
+        if position >= n - 1:
+            return values[-1] + (t - start - (n - 1) * spacing) * tangents[-1]
+        k = int(position)
+        s = position - k
+        s2, s3 = s * s, s * s * s
+        return (
+            (2 * s3 - 3 * s2 + 1) * values[k]
+            + (s3 - 2 * s2 + s) * spacing * tangents[k]
+            + (-2 * s3 + 3 * s2) * values[k + 1]
+            + (s3 - s2) * spacing * tangents[k + 1]
+        )
+
+    return evaluate
+
+
+def residual_cents(model, x, y):
+    # the model maps wanted to played semitones, error converted back through its slope
+    errors = []
+    for xi, yi in zip(x, y):
+        slope = (model(xi + 0.01) - model(xi - 0.01)) / 0.02
+        errors.append(100 * (model(xi) - yi) / slope)
+    return errors
+
+
+def load(run):
+    profiles = {}
+    with open(run) as f:
+        for row in csv.DictReader(f, skipinitialspace=True):
+            key = (int(row["voice"]), row["type"].strip())
+            x, y = profiles.setdefault(key, ([], []))
+            x.append(float(row["actual_semis"]))
+            y.append(float(row["test_semis"]))
+    return profiles
+
+
+def summary(errors):
+    rms = math.sqrt(sum(e * e for e in errors) / len(errors))
+    return f"{rms:8.2f} {max(abs(e) for e in errors):8.2f}"
+
+
+def report(title, cases):
+    print(title)
+    print(f"{'':16} {'parabola rms':>12} {'max':>8} {'spline rms':>12} {'max':>8}")
+    totals = {}
+    for name, train, test in cases:
+        row = f"{name:16}"
+        for fit in (fit_parabola, fit_spline):
+            errors = residual_cents(fit(*train), *test)
+            totals.setdefault(fit, []).extend(errors)
+            row += f" {summary(errors):>21}"
+        print(row)
+    print(f"{'all':16}" + "".join(f" {summary(e):>21}" for e in totals.values()))
+    print()
+
+
+dense, sparse = (load(run) for run in runs)
+
+for run, profiles in zip(runs, (dense, sparse)):
+    report(f"{run}, in sample", [(f"{v} {t}", xy, xy) for (v, t), xy in profiles.items()])
+    held_out = []
+    for (v, t), (x, y) in profiles.items():
+        held_out.append((f"{v} {t}", (x[::2], y[::2]), (x[1::2], y[1::2])))
+    report(f"{run}, held out", held_out)
+
+report("cross run", [(f"{v} {t}", sparse[(v, t)], dense[(v, t)]) for v, t in dense])